@@ -0,0 +1,12 @@
+#!/usr/bin/sh
+set -xe
+CFLAGS="-Wall -Wextra -pedantic -O2 -std=c99"
+mkdir -p build
+gcc $CFLAGS -pthread -o build/ipc_bench bench/ipc_bench.c src/i3_ipc.c src/utils.c
+./build/ipc_bench
+gcc $CFLAGS -o build/number_bench bench/number_bench.c src/utils.c
+./build/number_bench
+gcc $CFLAGS -pthread -o build/write_bench bench/write_bench.c bench/corpus.c src/json.c src/json_tape.c src/utils.c
+./build/write_bench
+gcc $CFLAGS -pthread -o build/lex_bench bench/lex_bench.c bench/corpus.c src/json.c src/utils.c
+./build/lex_bench
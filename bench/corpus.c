@@ -0,0 +1,37 @@
+#include "./corpus.h"
+
+#include <string.h>
+
+void corpus_append_rect(Arena *arena, String *out, const char *key, int x, int y) {
+    str_append_fmt(arena, out, "\"%s\":{\"x\":%d,\"y\":%d,\"width\":1920,\"height\":1080},", key, x, y);
+}
+
+void corpus_tree_generate(Arena *arena, String *out) {
+    int64_t id = 94000000000000;
+    str_append_fmt(arena, out, "{\"id\":%lld,\"type\":\"root\",\"name\":\"root\",\"nodes\":[", (long long)id++);
+    for (int o = 0; o < CORPUS_OUTPUTS_COUNT; ++o) {
+        str_append_fmt(arena, out, "%s{\"id\":%lld,\"type\":\"output\",\"name\":\"DP-%d\",", o ? "," : "", (long long)id++, o);
+        corpus_append_rect(arena, out, "rect", o * 1920, 0);
+        str_append_cstr(arena, out, "\"nodes\":[");
+        for (int w = 0; w < CORPUS_WORKSPACES_PER_OUTPUT; ++w) {
+            str_append_fmt(arena, out, "%s{\"id\":%lld,\"type\":\"workspace\",\"name\":\"%d\",\"num\":%d,",
+                           w ? "," : "", (long long)id++, w + 1, w + 1);
+            corpus_append_rect(arena, out, "rect", o * 1920, 0);
+            str_append_cstr(arena, out, "\"nodes\":[");
+            for (int c = 0; c < CORPUS_WINDOWS_PER_WORKSPACE; ++c) {
+                str_append_fmt(arena, out, "%s{\"id\":%lld,\"type\":\"con\",\"name\":\"%s \\\"notes\\\" %d \\u2014 Editor\",",
+                               c ? "," : "", (long long)id++, (c % 2) ? "README.md" : "main.c", c);
+                str_append_fmt(arena, out, "\"percent\":%.17g,\"urgent\":false,\"focused\":%s,\"marks\":[],",
+                               1.0 / CORPUS_WINDOWS_PER_WORKSPACE, (c == 0) ? "true" : "false");
+                corpus_append_rect(arena, out, "rect", o * 1920, c);
+                corpus_append_rect(arena, out, "deco_rect", 0, 0);
+                str_append_fmt(arena, out, "\"window\":%d,\"window_properties\":{\"class\":\"Emacs\","
+                               "\"instance\":\"emacs\",\"title\":\"main.c\\tbuffer %d\",\"transient_for\":null},"
+                               "\"nodes\":[],\"floating_nodes\":[]}", 20971520 + c, c);
+            }
+            str_append_cstr(arena, out, "],\"floating_nodes\":[]}");
+        }
+        str_append_cstr(arena, out, "]}");
+    }
+    str_append_cstr(arena, out, "]}");
+}
@@ -0,0 +1,15 @@
+#ifndef CORPUS_H_
+#define CORPUS_H_
+
+#include "../src/arena.h"
+#include "../src/utils.h"
+
+#define CORPUS_OUTPUTS_COUNT 4
+#define CORPUS_WORKSPACES_PER_OUTPUT 10
+#define CORPUS_WINDOWS_PER_WORKSPACE 800
+
+// NOTE(nic): the document the benchmarks run on, shaped like a GET_TREE reply of about 13 MB,
+// with the escapes and decimals real window titles and layouts bring
+void corpus_tree_generate(Arena *arena, String *out);
+
+#endif // CORPUS_H_
@@ -0,0 +1,140 @@
+// NOTE(nic): for socketpair and clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "../src/i3_ipc.h"
+#include "../src/utils.h"
+
+#define ARENA_IMPLEMENTATION
+#include "../src/arena.h"
+
+// NOTE(nic): the requests a menu that needs more than the tree would send, in one go
+static const uint32_t batch_types[] = {
+    I3_MSG_GET_TREE, I3_MSG_GET_WORKSPACES, I3_MSG_GET_MARKS, I3_MSG_GET_VERSION,
+};
+#define BATCH_COUNT (sizeof(batch_types)/sizeof(*batch_types))
+
+#define ROUNDS 2000
+
+typedef struct {
+    I3_Ipc ipc;
+    String tree;
+} Responder;
+
+// NOTE(nic): answers every request right away, like i3 would but without the cost of building the replies
+void *responder_run(void *arg) {
+    Responder *responder = arg;
+    while (true) {
+        I3_Ipc_Header header = {0};
+        String_View payload = {0};
+        if (!i3_ipc_receive(&responder->ipc, &header, &payload)) {
+            return NULL;
+        }
+        String_View reply = SV("{}");
+        switch (header.type) {
+        case I3_MSG_GET_TREE: reply = (String_View) { responder->tree.items, responder->tree.count }; break;
+        case I3_MSG_GET_WORKSPACES: reply = SV("[{\"num\":1,\"name\":\"1\",\"focused\":true}]"); break;
+        case I3_MSG_GET_MARKS: reply = SV("[\"m\"]"); break;
+        case I3_MSG_GET_VERSION: reply = SV("{\"major\":4,\"minor\":23,\"patch\":0}"); break;
+        }
+        if (!i3_ipc_send(&responder->ipc, header.type, reply)) {
+            return NULL;
+        }
+    }
+}
+
+double now_ms(void) {
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+void fail(I3_Ipc *ipc) {
+    fprintf(stderr, "Error: %s\n", ipc->error);
+    exit(1);
+}
+
+void batch_serial(I3_Ipc *ipc) {
+    for (size_t i = 0; i < BATCH_COUNT; ++i) {
+        String_View payload = {0};
+        if (!i3_ipc_send(ipc, batch_types[i], SV("")) || !i3_ipc_receive_reply(ipc, batch_types[i], &payload)) {
+            fail(ipc);
+        }
+    }
+}
+
+void batch_pipelined(I3_Ipc *ipc) {
+    I3_Ipc_Request requests[BATCH_COUNT] = {0};
+    for (size_t i = 0; i < BATCH_COUNT; ++i) {
+        requests[i].type = batch_types[i];
+    }
+    if (!i3_ipc_send_requests(ipc, requests, BATCH_COUNT)) {
+        fail(ipc);
+    }
+    for (size_t pending = BATCH_COUNT; pending > 0; --pending) {
+        I3_Ipc_Header header = {0};
+        String_View payload = {0};
+        if (!i3_ipc_receive(ipc, &header, &payload)) {
+            fail(ipc);
+        }
+        if (i3_ipc_match_reply(requests, BATCH_COUNT, header.type) == NULL) {
+            fprintf(stderr, "Error: reply of type %u matches no request\n", header.type);
+            exit(1);
+        }
+    }
+}
+
+void bench(size_t tree_size) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        perror("socketpair");
+        exit(1);
+    }
+    Responder responder = { .ipc = i3_ipc_from_fd(fds[1]) };
+    Arena arena = {0};
+    responder.tree = str_with_cap(&arena, tree_size);
+    memset(responder.tree.items, ' ', tree_size);
+    responder.tree.count = tree_size;
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, responder_run, &responder);
+
+    I3_Ipc ipc = i3_ipc_from_fd(fds[0]);
+    // NOTE(nic): warm up, the buffers only grow on the first few replies
+    batch_serial(&ipc);
+    batch_pipelined(&ipc);
+
+    double start = now_ms();
+    for (size_t i = 0; i < ROUNDS; ++i) {
+        batch_serial(&ipc);
+    }
+    double serial = (now_ms() - start) / ROUNDS;
+
+    start = now_ms();
+    for (size_t i = 0; i < ROUNDS; ++i) {
+        batch_pipelined(&ipc);
+    }
+    double pipelined = (now_ms() - start) / ROUNDS;
+
+    printf("tree %8zu bytes: serial %.4f ms/batch, pipelined %.4f ms/batch\n", tree_size, serial, pipelined);
+
+    i3_ipc_close(&ipc);
+    pthread_join(thread, NULL);
+    i3_ipc_close(&responder.ipc);
+    arena_free(&arena);
+}
+
+int main(void) {
+    size_t tree_sizes[] = { 4*1024, 64*1024, 1024*1024 };
+    for (size_t i = 0; i < sizeof(tree_sizes)/sizeof(*tree_sizes); ++i) {
+        bench(tree_sizes[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+// NOTE(nic): for clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/json.h"
+#include "../src/utils.h"
+#include "./corpus.h"
+
+#define ARENA_IMPLEMENTATION
+#include "../src/arena.h"
+
+double now_ms(void) {
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// NOTE(nic): the tokens in the input, by the plainest walk there is, json_lexer_next until the end and no peeking
+size_t count_tokens(String_View content) {
+    Json_Lexer lexer = { .content = content };
+    size_t count = 0;
+    while (true) {
+        Json_Token token = {0};
+        Json_Result result = json_lexer_next(&lexer, &token);
+        if (result.failed) {
+            fprintf(stderr, "Error: corpus does not lex at %zu: %s\n", result.error_loc, result.error);
+            exit(1);
+        }
+        if (token.kind == JSON_TOKEN_END) {
+            return count;
+        }
+        count += 1;
+    }
+}
+
+// NOTE(nic): parses like json_parse does, with the lexer out where its counter can be read
+bool parse_counted(String_View content, bool indexed, size_t expected) {
+    Arena arena = {0};
+    Json_Interner interner = {0};
+    Json_Lexer lexer = { .content = content, .interner = &interner };
+    if (indexed) {
+        json_lexer_attach_index(&arena, &lexer);
+    }
+    Json_Object root = {0};
+    double start = now_ms();
+    Json_Result result = json_parse_object(&arena, &lexer, &root);
+    double elapsed = now_ms() - start;
+    arena_free(&arena);
+    if (result.failed) {
+        fprintf(stderr, "Error: corpus does not parse at %zu: %s\n", result.error_loc, result.error);
+        exit(1);
+    }
+    printf("%-9s: %zu tokens lexed, parsed in %.1f ms\n", indexed ? "indexed" : "unindexed", lexer.tokens_scanned, elapsed);
+    return lexer.tokens_scanned == expected;
+}
+
+int main(void) {
+    Arena arena = {0};
+    String input = {0};
+    corpus_tree_generate(&arena, &input);
+    String_View content = { input.items, input.count };
+
+    size_t expected = count_tokens(content);
+    printf("tokens   : %zu in the input\n", expected);
+    bool indexed = parse_counted(content, true, expected);
+    bool unindexed = parse_counted(content, false, expected);
+    arena_free(&arena);
+    if (!indexed || !unindexed) {
+        fprintf(stderr, "Error: the parser lexed some tokens more than once\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+// NOTE(nic): for clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/utils.h"
+
+#define ARENA_IMPLEMENTATION
+#include "../src/arena.h"
+
+#define NUMBERS_COUNT 4096
+#define ROUNDS 500
+
+// NOTE(nic): what sv_to_int64 and sv_to_decimal used to do, copy into a VLA and hand it to libc
+int64_t old_sv_to_int64(String_View sv) {
+    char int64_string[sv.size + 1];
+    memcpy(int64_string, sv.data, sv.size);
+    int64_string[sv.size] = '\0';
+    return atoll(int64_string);
+}
+
+double old_sv_to_decimal(String_View sv) {
+    char decimal_string[sv.size + 1];
+    memcpy(decimal_string, sv.data, sv.size);
+    decimal_string[sv.size] = '\0';
+    return strtod(decimal_string, NULL);
+}
+
+double now_ns(void) {
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+typedef struct {
+    String_View text;
+    bool is_integer;
+} Number;
+
+// NOTE(nic): the mix an i3 tree has, mostly container ids and X window ids, some rect fields and a few percents
+void numbers_generate(Arena *arena, Number *numbers, size_t count) {
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < count; ++i) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        uint32_t r = (uint32_t)(seed >> 33);
+        const char *text = NULL;
+        bool is_integer = true;
+        switch (i % 8) {
+        case 0: case 1: case 2: text = arena_sprintf(arena, "%llu", 94000000000000ull + r); break;
+        case 3: text = arena_sprintf(arena, "%u", 20971520u + r % 1000000u); break;
+        case 4: case 5: text = arena_sprintf(arena, "%u", r % 3841u); break;
+        case 6: text = arena_sprintf(arena, "0.%u", r % 1000u); is_integer = false; break;
+        case 7: text = arena_sprintf(arena, "%u.%05u", r % 100u, r % 100000u); is_integer = false; break;
+        }
+        numbers[i] = (Number) { SV(text), is_integer };
+    }
+}
+
+int main(void) {
+    Arena arena = {0};
+    static Number numbers[NUMBERS_COUNT];
+    numbers_generate(&arena, numbers, NUMBERS_COUNT);
+
+    for (size_t i = 0; i < NUMBERS_COUNT; ++i) {
+        bool same = numbers[i].is_integer
+            ? sv_to_int64(numbers[i].text) == old_sv_to_int64(numbers[i].text)
+            : sv_to_decimal(numbers[i].text) == old_sv_to_decimal(numbers[i].text);
+        if (!same) {
+            fprintf(stderr, "Error: %.*s parses differently\n", (int)numbers[i].text.size, numbers[i].text.data);
+            return 1;
+        }
+    }
+
+    // NOTE(nic): summed so the calls can not be optimized away
+    volatile double sink = 0;
+    double start = now_ns();
+    for (size_t round = 0; round < ROUNDS; ++round) {
+        for (size_t i = 0; i < NUMBERS_COUNT; ++i) {
+            sink += numbers[i].is_integer ? (double)old_sv_to_int64(numbers[i].text) : old_sv_to_decimal(numbers[i].text);
+        }
+    }
+    double old_ns = (now_ns() - start) / (ROUNDS * NUMBERS_COUNT);
+
+    start = now_ns();
+    for (size_t round = 0; round < ROUNDS; ++round) {
+        for (size_t i = 0; i < NUMBERS_COUNT; ++i) {
+            sink += numbers[i].is_integer ? (double)sv_to_int64(numbers[i].text) : sv_to_decimal(numbers[i].text);
+        }
+    }
+    double new_ns = (now_ns() - start) / (ROUNDS * NUMBERS_COUNT);
+
+    printf("numbers: old %.1f ns/number, new %.1f ns/number\n", old_ns, new_ns);
+    arena_free(&arena);
+    return 0;
+}
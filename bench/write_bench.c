@@ -0,0 +1,149 @@
+// NOTE(nic): for clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "../src/json.h"
+#include "../src/json_tape.h"
+#include "../src/utils.h"
+#include "./corpus.h"
+
+#define ARENA_IMPLEMENTATION
+#include "../src/arena.h"
+
+#define ROUNDS 5
+
+// NOTE(nic): what json_print_obj used to be, a printf per token
+void old_print_obj(Json_Object *obj);
+
+void old_print_dict(Json_Dict *dict) {
+    printf("{");
+    for (size_t i = 0; i < dict->count; ++i) {
+        old_print_obj(&dict->items[i].key);
+        printf(": ");
+        old_print_obj(&dict->items[i].value);
+        if (i < dict->count - 1) {
+            printf(", ");
+        }
+    }
+    printf("}");
+}
+
+void old_print_array(Json_Array *array) {
+    printf("[");
+    for (size_t i = 0; i < array->count; ++i) {
+        old_print_obj(&array->items[i]);
+        if (i < array->count - 1) {
+            printf(", ");
+        }
+    }
+    printf("]");
+}
+
+void old_print_obj(Json_Object *obj) {
+    switch (obj->kind) {
+    case JSON_OBJ_NULL:
+        printf("null");
+        break;
+    case JSON_OBJ_DICT:
+        old_print_dict(&obj->as.dict);
+        break;
+    case JSON_OBJ_ARRAY:
+        old_print_array(&obj->as.array);
+        break;
+    case JSON_OBJ_BOOLEAN:
+        printf("%s", (obj->as.boolean) ? "true" : "false");
+        break;
+    case JSON_OBJ_INT64:
+        printf("%lld", (long long)obj->as.int64);
+        break;
+    case JSON_OBJ_DECIMAL:
+        printf("%f", obj->as.decimal);
+        break;
+    case JSON_OBJ_STRING:
+        printf("\"%.*s\"", (int)obj->as.string.count, obj->as.string.items);
+        break;
+    default:
+        assert(0 && "unreachable");
+    }
+}
+
+double now_ms(void) {
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+bool str_same(String *a, String *b) {
+    return a->count == b->count && memcmp(a->items, b->items, a->count) == 0;
+}
+
+int main(void) {
+    Arena arena = {0};
+    String input = {0};
+    corpus_tree_generate(&arena, &input);
+
+    Json_Object root = {0};
+    Json_Result result = json_parse(&arena, &root, input.items, input.count);
+    assert(!result.failed);
+    Json_Tape tape = {0};
+    result = json_tape_parse(&arena, &tape, input.items, input.count);
+    assert(!result.failed);
+
+    printf("tree: %zu bytes\n", input.count);
+    Json_Write_Mode modes[] = { JSON_WRITE_COMPACT, JSON_WRITE_PRETTY };
+    const char *mode_names[] = { "compact", "pretty" };
+    for (size_t m = 0; m < sizeof(modes)/sizeof(*modes); ++m) {
+        // NOTE(nic): the best of a few rounds, each into a fresh arena so growing the output is part of it
+        double dom_ms = 0;
+        double tape_ms = 0;
+        bool same = true;
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            Arena out_arena = {0};
+            String dom_out = {0};
+            double start = now_ms();
+            json_write_obj(&out_arena, &dom_out, &root, modes[m]);
+            double elapsed = now_ms() - start;
+            dom_ms = (round == 0 || elapsed < dom_ms) ? elapsed : dom_ms;
+
+            String tape_out = {0};
+            start = now_ms();
+            json_tape_write(&out_arena, &tape_out, &tape, 0, modes[m]);
+            elapsed = now_ms() - start;
+            tape_ms = (round == 0 || elapsed < tape_ms) ? elapsed : tape_ms;
+
+            // NOTE(nic): writing what was written gives the same bytes again
+            Json_Object reparsed = {0};
+            result = json_parse(&out_arena, &reparsed, dom_out.items, dom_out.count);
+            String rewritten = {0};
+            json_write_obj(&out_arena, &rewritten, &reparsed, modes[m]);
+            same = same && !result.failed && str_same(&dom_out, &tape_out) && str_same(&dom_out, &rewritten);
+            arena_free(&out_arena);
+        }
+        if (!same) {
+            fprintf(stderr, "Error: %s output does not round trip\n", mode_names[m]);
+            return 1;
+        }
+        printf("%-7s: dom %.0f MB/s, tape %.0f MB/s\n", mode_names[m],
+               input.count / 1000.0 / dom_ms, input.count / 1000.0 / tape_ms);
+    }
+
+    fflush(stdout);
+    FILE *out = freopen("/dev/null", "w", stdout);
+    assert(out != NULL);
+    double start = now_ms();
+    old_print_obj(&root);
+    fflush(stdout);
+    double old_ms = now_ms() - start;
+    start = now_ms();
+    json_print_obj(&root);
+    fflush(stdout);
+    double new_ms = now_ms() - start;
+    fprintf(stderr, "print  : printf per token %.0f ms, json_print_obj %.0f ms\n", old_ms, new_ms);
+
+    arena_free(&arena);
+    return 0;
+}
@@ -2,4 +2,4 @@
 set -xe
 
 CFLAGS="-Wall -Wextra -pedantic -ggdb -std=c99"
-gcc $CFLAGS -o dmenu_scratch src/main.c src/json.c src/utils.c
+gcc $CFLAGS -pthread -o dmenu_scratch src/main.c src/json.c src/json_tape.c src/json_query.c src/i3_ipc.c src/utils.c
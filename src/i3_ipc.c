@@ -0,0 +1,205 @@
+// NOTE(nic): for MSG_NOSIGNAL
+#define _POSIX_C_SOURCE 200809L
+
+#include "./i3_ipc.h"
+#include "./arena.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+I3_Ipc i3_ipc_from_fd(int fd) {
+    I3_Ipc ipc = {0};
+    ipc.fd = fd;
+    return ipc;
+}
+
+void i3_ipc_close(I3_Ipc *ipc) {
+    if (ipc->fd >= 0) {
+        close(ipc->fd);
+    }
+    arena_free(&ipc->arena);
+    *ipc = i3_ipc_from_fd(-1);
+}
+
+bool i3_ipc_fail(I3_Ipc *ipc, const char *error) {
+    ipc->error = error;
+    return false;
+}
+
+void i3_ipc_write_uint32_le(uint8_t *bytes, uint32_t n) {
+    for (size_t i = 0; i < sizeof(uint32_t); ++i) {
+        bytes[i] = (n >> (i * 8)) & 0xFF;
+    }
+}
+
+uint32_t i3_ipc_read_uint32_le(const uint8_t *bytes) {
+    uint32_t n = 0;
+    for (size_t i = 0; i < sizeof(uint32_t); ++i) {
+        n |= (uint32_t)bytes[i] << (i * 8);
+    }
+    return n;
+}
+
+void i3_ipc_write_header(uint8_t *header, uint32_t type, uint32_t size) {
+    memcpy(header, I3_IPC_MAGIC, strlen(I3_IPC_MAGIC));
+    i3_ipc_write_uint32_le(&header[6], size);
+    i3_ipc_write_uint32_le(&header[10], type);
+}
+
+// NOTE(nic): sendmsg rather than writev, only the former takes MSG_NOSIGNAL so i3 going away is not fatal
+bool i3_ipc_send_iov(I3_Ipc *ipc, struct iovec *iov, size_t iov_count) {
+    struct msghdr msg = {0};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_count;
+    while (msg.msg_iovlen > 0) {
+        ssize_t bytes_sent = sendmsg(ipc->fd, &msg, MSG_NOSIGNAL);
+        if (bytes_sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return i3_ipc_fail(ipc, strerror(errno));
+        }
+        // NOTE(nic): partial write, drop whatever went out and go again with the rest
+        size_t sent = (size_t)bytes_sent;
+        while (msg.msg_iovlen > 0 && sent >= msg.msg_iov[0].iov_len) {
+            sent -= msg.msg_iov[0].iov_len;
+            msg.msg_iov += 1;
+            msg.msg_iovlen -= 1;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov[0].iov_base = (char *)msg.msg_iov[0].iov_base + sent;
+            msg.msg_iov[0].iov_len -= sent;
+        }
+    }
+    return true;
+}
+
+bool i3_ipc_send(I3_Ipc *ipc, uint32_t type, String_View payload) {
+    I3_Ipc_Request request = { .type = type, .payload = payload };
+    return i3_ipc_send_requests(ipc, &request, 1);
+}
+
+bool i3_ipc_send_requests(I3_Ipc *ipc, I3_Ipc_Request *requests, size_t count) {
+    uint8_t headers[I3_IPC_SEND_BATCH][I3_IPC_HEADER_SIZE];
+    struct iovec iov[2*I3_IPC_SEND_BATCH];
+    for (size_t begin = 0; begin < count; begin += I3_IPC_SEND_BATCH) {
+        size_t iov_count = 0;
+        for (size_t i = 0; i < I3_IPC_SEND_BATCH && begin + i < count; ++i) {
+            I3_Ipc_Request *request = &requests[begin + i];
+            if (request->payload.size > I3_IPC_MAX_MESSAGE_SIZE) {
+                return i3_ipc_fail(ipc, "message too big");
+            }
+            request->received = false;
+            i3_ipc_write_header(headers[i], request->type, (uint32_t)request->payload.size);
+            iov[iov_count++] = (struct iovec) { .iov_base = headers[i], .iov_len = I3_IPC_HEADER_SIZE };
+            if (request->payload.size > 0) {
+                iov[iov_count++] = (struct iovec) {
+                    .iov_base = (void *)request->payload.data,
+                    .iov_len = request->payload.size,
+                };
+            }
+        }
+        if (!i3_ipc_send_iov(ipc, iov, iov_count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool i3_ipc_read(I3_Ipc *ipc, char *data, size_t size, size_t *received) {
+    while (true) {
+        ssize_t bytes_received = recv(ipc->fd, data, size, 0);
+        if (bytes_received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return i3_ipc_fail(ipc, strerror(errno));
+        }
+        if (bytes_received == 0) {
+            return i3_ipc_fail(ipc, "connection closed by i3");
+        }
+        *received = (size_t)bytes_received;
+        return true;
+    }
+}
+
+bool i3_ipc_read_all(I3_Ipc *ipc, char *data, size_t size) {
+    while (size > 0) {
+        size_t received = 0;
+        if (!i3_ipc_read(ipc, data, size, &received)) {
+            return false;
+        }
+        data += received;
+        size -= received;
+    }
+    return true;
+}
+
+bool i3_ipc_receive_header(I3_Ipc *ipc, I3_Ipc_Header *header) {
+    uint8_t bytes[I3_IPC_HEADER_SIZE];
+    if (!i3_ipc_read_all(ipc, (char *)bytes, sizeof(bytes))) {
+        return false;
+    }
+    if (memcmp(bytes, I3_IPC_MAGIC, strlen(I3_IPC_MAGIC)) != 0) {
+        return i3_ipc_fail(ipc, "invalid magic in message header");
+    }
+    header->size = i3_ipc_read_uint32_le(&bytes[6]);
+    header->type = i3_ipc_read_uint32_le(&bytes[10]);
+    if (header->size > I3_IPC_MAX_MESSAGE_SIZE) {
+        return i3_ipc_fail(ipc, "message too big");
+    }
+    return true;
+}
+
+bool i3_ipc_receive(I3_Ipc *ipc, I3_Ipc_Header *header, String_View *payload) {
+    return i3_ipc_receive_header(ipc, header) && i3_ipc_receive_payload(ipc, header, payload);
+}
+
+bool i3_ipc_receive_payload(I3_Ipc *ipc, I3_Ipc_Header *header, String_View *payload) {
+    if (header->size == 0) {
+        // NOTE(nic): the buffer may not exist yet, an empty payload still points somewhere
+        ipc->buffer.count = 0;
+        *payload = SV_EMPTY;
+        return true;
+    }
+    if (header->size > ipc->buffer.capacity) {
+        // NOTE(nic): the buffer is all the arena holds, so growing it is starting the arena over
+        size_t capacity = (ipc->buffer.capacity > 0) ? ipc->buffer.capacity : ARENA_DA_INIT_CAP;
+        while (capacity < header->size) {
+            capacity *= 2;
+        }
+        arena_free(&ipc->arena);
+        ipc->buffer = str_with_cap(&ipc->arena, capacity);
+    }
+    if (!i3_ipc_read_all(ipc, ipc->buffer.items, header->size)) {
+        return false;
+    }
+    ipc->buffer.count = header->size;
+    *payload = (String_View) { ipc->buffer.items, ipc->buffer.count };
+    return true;
+}
+
+bool i3_ipc_receive_reply(I3_Ipc *ipc, uint32_t type, String_View *payload) {
+    I3_Ipc_Header header = {0};
+    if (!i3_ipc_receive(ipc, &header, payload)) {
+        return false;
+    }
+    if (header.type != type) {
+        return i3_ipc_fail(ipc, "unexpected message type in reply");
+    }
+    return true;
+}
+
+I3_Ipc_Request *i3_ipc_match_reply(I3_Ipc_Request *requests, size_t count, uint32_t type) {
+    for (size_t i = 0; i < count; ++i) {
+        if (!requests[i].received && requests[i].type == type) {
+            requests[i].received = true;
+            return &requests[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,81 @@
+#ifndef I3_IPC_H_
+#define I3_IPC_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "./arena.h"
+#include "./utils.h"
+
+#define I3_IPC_MAGIC "i3-ipc"
+#define I3_IPC_HEADER_SIZE 14 // in bytes
+
+// NOTE(nic): a header announcing more than this is taken for garbage on the socket, not allocated for
+#define I3_IPC_MAX_MESSAGE_SIZE (1u << 30)
+
+typedef enum {
+    I3_MSG_RUN_COMMAND = 0,
+    I3_MSG_GET_WORKSPACES = 1,
+    I3_MSG_SUBSCRIBE = 2,
+    I3_MSG_GET_TREE = 4,
+    I3_MSG_GET_MARKS = 5,
+    I3_MSG_GET_VERSION = 7,
+} I3_Message_Type;
+
+// NOTE(nic): events share the message type field, with the highest bit set
+// (which is also why they can not live in the enum above)
+#define I3_EVENT_MASK 0x80000000u
+#define I3_EVENT_WORKSPACE (I3_EVENT_MASK | 0)
+#define I3_EVENT_WINDOW (I3_EVENT_MASK | 3)
+
+typedef struct {
+    uint32_t type;
+    uint32_t size; // NOTE(nic): of the payload that follows
+} I3_Ipc_Header;
+
+// NOTE(nic): one connection to i3. Every call returns false on failure and leaves what went wrong in `error`,
+// after that the connection is out of sync and only good for closing.
+typedef struct {
+    int fd;
+    const char *error;
+    Arena arena;   // NOTE(nic): holds nothing but `buffer`
+    String buffer; // NOTE(nic): shared by every i3_ipc_receive, only grows to fit the biggest message so far
+} I3_Ipc;
+
+I3_Ipc i3_ipc_from_fd(int fd);
+void i3_ipc_close(I3_Ipc *ipc);
+
+// NOTE(nic): header and payload go out in one vectored send, no matter how many calls it takes
+bool i3_ipc_send(I3_Ipc *ipc, uint32_t type, String_View payload);
+
+bool i3_ipc_receive_header(I3_Ipc *ipc, I3_Ipc_Header *header);
+// NOTE(nic): reads whatever is there, at least one and up to `size` bytes
+bool i3_ipc_read(I3_Ipc *ipc, char *data, size_t size, size_t *received);
+bool i3_ipc_read_all(I3_Ipc *ipc, char *data, size_t size);
+
+// NOTE(nic): the payload lives in `buffer`, so it is only good until the next receive
+bool i3_ipc_receive(I3_Ipc *ipc, I3_Ipc_Header *header, String_View *payload);
+// NOTE(nic): same, for the payload of a header that was already received
+bool i3_ipc_receive_payload(I3_Ipc *ipc, I3_Ipc_Header *header, String_View *payload);
+// NOTE(nic): same, failing unless the message is of the given type
+bool i3_ipc_receive_reply(I3_Ipc *ipc, uint32_t type, String_View *payload);
+
+// NOTE(nic): several requests go out back to back before any reply is read, so their round trips overlap
+typedef struct {
+    uint32_t type;
+    String_View payload;
+    bool received;
+} I3_Ipc_Request;
+
+// NOTE(nic): requests per sendmsg, two iovecs each keeps it within the smallest IOV_MAX POSIX allows
+#define I3_IPC_SEND_BATCH 8
+
+bool i3_ipc_send_requests(I3_Ipc *ipc, I3_Ipc_Request *requests, size_t count);
+
+// NOTE(nic): hands back the oldest request of the given type still waiting for a reply, marked as received,
+// NULL if there is none (e.g. for events). Replies are matched by type rather than assumed to come in order.
+// Reading the payload is up to the caller, into the buffer or e.g. straight into a tape parser.
+I3_Ipc_Request *i3_ipc_match_reply(I3_Ipc_Request *requests, size_t count, uint32_t type);
+
+#endif // I3_IPC_H_
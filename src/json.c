@@ -7,6 +7,13 @@
 #include <string.h>
 #include <ctype.h>
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define JSON_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define JSON_X86_SIMD 0
+#endif
+
 typedef struct {
     String_View sv;
     Json_Token_Kind kind;
@@ -88,11 +95,398 @@ bool json_lexer_starts_with_char(Json_Lexer *lexer, char ch) {
     return lexer->cursor < lexer->content.size && lexer->content.data[lexer->cursor] == ch;
 }
 
-int json_is_number_char(int ch) {
-    return isdigit(ch) || ch == '-' || ch == '.';
+// NOTE(nic): everything that can continue a keyword or a number
+int json_is_literal_char(int ch) {
+    return isalnum((unsigned char)ch) || ch == '.' || ch == '+' || ch == '-';
 }
 
-Json_Result json_lexer_next(Json_Lexer *lexer, Json_Token *token) {
+int json_hex_digit(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+bool json_parse_hex4(const char *data, uint32_t *code_point) {
+    *code_point = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        int digit = json_hex_digit(data[i]);
+        if (digit < 0) {
+            return false;
+        }
+        *code_point = (*code_point << 4) | (uint32_t)digit;
+    }
+    return true;
+}
+
+// NOTE(nic): `escape` points right past a backslash inside a string. Returns what is wrong with the escape there,
+// NULL if it is one JSON has. Only the escapes are checked while lexing, turning them into bytes is left
+// to json_string_decode.
+const char *json_check_escape(const char *escape, const char *end) {
+    if (escape >= end) {
+        return "unterminated escape sequence";
+    }
+    switch (*escape) {
+    case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+        return NULL;
+    case 'u': {
+        uint32_t code_point;
+        if (end - escape - 1 < 4 || !json_parse_hex4(escape + 1, &code_point)) {
+            return "invalid unicode escape";
+        }
+        return NULL;
+    }
+    default:
+        return "invalid special character";
+    }
+}
+
+// NOTE(nic): length of the JSON number at the start of `sv`, zero if there is none.
+// `-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?`
+size_t json_number_length(String_View sv, bool *is_integer) {
+    size_t i = 0;
+    *is_integer = true;
+    if (i < sv.size && sv.data[i] == '-') {
+        i += 1;
+    }
+    if (i < sv.size && sv.data[i] == '0') {
+        i += 1;
+    } else if (i < sv.size && sv.data[i] >= '1' && sv.data[i] <= '9') {
+        while (i < sv.size && isdigit(sv.data[i])) i += 1;
+    } else {
+        return 0;
+    }
+    if (i < sv.size && sv.data[i] == '.') {
+        i += 1;
+        if (i >= sv.size || !isdigit(sv.data[i])) {
+            return 0;
+        }
+        while (i < sv.size && isdigit(sv.data[i])) i += 1;
+        *is_integer = false;
+    }
+    if (i < sv.size && (sv.data[i] == 'e' || sv.data[i] == 'E')) {
+        i += 1;
+        if (i < sv.size && (sv.data[i] == '+' || sv.data[i] == '-')) {
+            i += 1;
+        }
+        if (i >= sv.size || !isdigit(sv.data[i])) {
+            return 0;
+        }
+        while (i < sv.size && isdigit(sv.data[i])) i += 1;
+        *is_integer = false;
+    }
+    return i;
+}
+
+typedef struct {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t structural;
+    uint64_t whitespace;
+    uint64_t newline;
+} Json_Block_Masks;
+
+typedef void (*Json_Classify_Func)(const uint8_t *block, Json_Block_Masks *masks);
+
+// NOTE(nic): every classifier fills one bit per byte of a 64 byte block
+void json_classify_scalar(const uint8_t *block, Json_Block_Masks *masks) {
+    *masks = (Json_Block_Masks) {0};
+    for (size_t i = 0; i < 64; ++i) {
+        uint64_t bit = 1ull << i;
+        switch (block[i]) {
+        case '"': masks->quote |= bit; break;
+        case '\\': masks->backslash |= bit; break;
+        case '{': case '}': case '[': case ']': case ':': case ',':
+            masks->structural |= bit;
+            break;
+        case '\n': masks->newline |= bit; masks->whitespace |= bit; break;
+        case ' ': case '\t': case '\r': masks->whitespace |= bit; break;
+        default: break;
+        }
+    }
+}
+
+#if JSON_X86_SIMD
+void json_classify_sse2(const uint8_t *block, Json_Block_Masks *masks) {
+    *masks = (Json_Block_Masks) {0};
+    for (size_t i = 0; i < 4; ++i) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(block + i*16));
+        // NOTE(nic): '[' | 0x20 == '{' and ']' | 0x20 == '}', saves two compares
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i structural = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+        __m128i newline = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+        __m128i whitespace = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), newline));
+        size_t shift = i*16;
+        masks->quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << shift;
+        masks->backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << shift;
+        masks->structural |= (uint64_t)(uint16_t)_mm_movemask_epi8(structural) << shift;
+        masks->whitespace |= (uint64_t)(uint16_t)_mm_movemask_epi8(whitespace) << shift;
+        masks->newline |= (uint64_t)(uint16_t)_mm_movemask_epi8(newline) << shift;
+    }
+}
+
+__attribute__((target("avx2")))
+void json_classify_avx2(const uint8_t *block, Json_Block_Masks *masks) {
+    *masks = (Json_Block_Masks) {0};
+    for (size_t i = 0; i < 2; ++i) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(block + i*32));
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i structural = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+        __m256i newline = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+        __m256i whitespace = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), newline));
+        size_t shift = i*32;
+        masks->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << shift;
+        masks->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << shift;
+        masks->structural |= (uint64_t)(uint32_t)_mm256_movemask_epi8(structural) << shift;
+        masks->whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(whitespace) << shift;
+        masks->newline |= (uint64_t)(uint32_t)_mm256_movemask_epi8(newline) << shift;
+    }
+}
+#endif // JSON_X86_SIMD
+
+Json_Classify_Func json_classify_select(void) {
+#if JSON_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return json_classify_avx2;
+    }
+    // NOTE(nic): SSE2 is part of x86_64 itself
+    return json_classify_sse2;
+#else
+    return json_classify_scalar;
+#endif
+}
+
+size_t json_ctz64(uint64_t n) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(n);
+#else
+    size_t count = 0;
+    while ((n & 1) == 0) {
+        n >>= 1;
+        count += 1;
+    }
+    return count;
+#endif
+}
+
+// NOTE(nic): backslashes are rare, so walking them one by one is cheaper than being clever.
+// `carry` tells whether the first byte of the block is escaped by the end of the previous one.
+uint64_t json_find_escaped(uint64_t backslash, uint64_t *carry) {
+    uint64_t escaped = *carry;
+    backslash &= ~escaped;
+    *carry = 0;
+    while (backslash != 0) {
+        size_t i = json_ctz64(backslash);
+        if (i == 63) {
+            *carry = 1;
+            break;
+        }
+        escaped |= 1ull << (i + 1);
+        backslash &= ~(3ull << i);
+    }
+    return escaped;
+}
+
+// NOTE(nic): bit i of the result is the xor of bits 0..i, which turns quote bits into "inside string" bits
+uint64_t json_prefix_xor(uint64_t n) {
+    n ^= n << 1;
+    n ^= n << 2;
+    n ^= n << 4;
+    n ^= n << 8;
+    n ^= n << 16;
+    n ^= n << 32;
+    return n;
+}
+
+// NOTE(nic): returns false when the input has an unclosed string (or a newline or an invalid escape inside
+// of one), in which case the byte by byte lexer is left to report the error at the right location
+bool json_build_structural_index(Arena *arena, String_View content, Json_Structural_Index *index) {
+    static Json_Classify_Func classify = NULL;
+    if (classify == NULL) {
+        classify = json_classify_select();
+    }
+
+    *index = (Json_Structural_Index) {0};
+    if (content.size > UINT32_MAX) {
+        return false;
+    }
+
+    const uint8_t *data = (const uint8_t *)content.data;
+    uint64_t prev_escaped = 0;
+    uint64_t prev_in_string = 0;
+    uint64_t prev_scalar = 0;
+    for (size_t base = 0; base < content.size; base += 64) {
+        const uint8_t *block = &data[base];
+        uint8_t tail[64];
+        if (content.size - base < 64) {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, block, content.size - base);
+            block = tail;
+        }
+
+        Json_Block_Masks masks = {0};
+        classify(block, &masks);
+
+        uint64_t escaped = json_find_escaped(masks.backslash, &prev_escaped);
+        uint64_t quote = masks.quote & ~escaped;
+        uint64_t in_string = json_prefix_xor(quote) ^ prev_in_string;
+        prev_in_string = (uint64_t)0 - (in_string >> 63);
+        if ((masks.newline & in_string) != 0) {
+            return false;
+        }
+        for (uint64_t escapes = escaped & in_string; escapes != 0; escapes &= escapes - 1) {
+            const char *escape = content.data + base + json_ctz64(escapes);
+            if (json_check_escape(escape, content.data + content.size) != NULL) {
+                return false;
+            }
+        }
+
+        uint64_t structural = masks.structural & ~in_string;
+        uint64_t scalar = ~(masks.structural | masks.whitespace | masks.quote | in_string);
+        uint64_t scalar_start = scalar & ~((scalar << 1) | prev_scalar);
+        prev_scalar = scalar >> 63;
+
+        uint64_t bits = structural | quote | scalar_start;
+        if (index->count + 64 > index->capacity) {
+            size_t capacity = (index->capacity == 0) ? ARENA_DA_INIT_CAP : index->capacity*2;
+            index->items = arena_realloc(
+                arena, index->items,
+                index->capacity*sizeof(*index->items),
+                capacity*sizeof(*index->items));
+            index->capacity = capacity;
+        }
+        while (bits != 0) {
+            index->items[index->count++] = (uint32_t)(base + json_ctz64(bits));
+            bits &= bits - 1;
+        }
+    }
+    return prev_in_string == 0;
+}
+
+void json_lexer_attach_index(Arena *arena, Json_Lexer *lexer) {
+    if (lexer->content.size < JSON_STRUCTURAL_INDEX_MIN_SIZE) {
+        return;
+    }
+    Json_Structural_Index *index = arena_alloc(arena, sizeof(*index));
+    if (json_build_structural_index(arena, lexer->content, index)) {
+        lexer->index = index;
+        lexer->index_cursor = 0;
+    }
+}
+
+Json_Result json_lexer_next_literal(Json_Lexer *lexer, Json_Token *token) {
+    Json_Result result = {0};
+    result.error_loc = lexer->cursor;
+    char ch = lexer->content.data[lexer->cursor];
+
+    if (isalpha(ch)) {
+        String_View word = json_lexer_consume_while(lexer, isalnum);
+        for (size_t i = 0; i < json_keywords_count; ++i) {
+            if (sv_eq(word, json_keywords[i].sv)) {
+                token->kind = json_keywords[i].kind;
+                token->text = word;
+                return result;
+            }
+        }
+        result.failed = true;
+        result.error = "unknown word";
+        return result;
+    }
+
+    if (ch == '-' || isdigit(ch)) {
+        String_View rest = { &lexer->content.data[lexer->cursor], lexer->content.size - lexer->cursor };
+        bool is_integer = false;
+        size_t size = json_number_length(rest, &is_integer);
+        // NOTE(nic): catches things like `01`, `1.2.3` or `--1` instead of splitting them into several tokens
+        if (size == 0 || (size < rest.size && json_is_literal_char(rest.data[size]))) {
+            result.failed = true;
+            result.error = "invalid number";
+            return result;
+        }
+        String_View number = json_lexer_consume_chars(lexer, size);
+        int64_t value;
+        // NOTE(nic): integers that do not fit in 64 bits are kept as decimals
+        token->kind = (is_integer && sv_parse_int64(number, &value)) ? JSON_TOKEN_INT64 : JSON_TOKEN_DECIMAL;
+        token->text = number;
+        return result;
+    }
+
+    result.failed = true;
+    result.error = "invalid character";
+    return result;
+}
+
+// NOTE(nic): whitespace and string contents never show up in the index, so both are skipped in one jump
+Json_Result json_lexer_next_indexed(Json_Lexer *lexer, Json_Token *token) {
+    Json_Result result = {0};
+    Json_Structural_Index *index = lexer->index;
+    if (lexer->index_cursor >= index->count) {
+        lexer->cursor = lexer->content.size;
+        result.error_loc = lexer->cursor;
+        token->loc = lexer->cursor;
+        token->kind = JSON_TOKEN_END;
+        token->text = SV("<end>");
+        return result;
+    }
+
+    size_t loc = index->items[lexer->index_cursor++];
+    lexer->cursor = loc;
+    result.error_loc = loc;
+    token->loc = loc;
+
+    Json_Token_Kind kind;
+    switch (lexer->content.data[loc]) {
+    case '{': kind = JSON_TOKEN_OPEN_CURLY; break;
+    case '}': kind = JSON_TOKEN_CLOSE_CURLY; break;
+    case '[': kind = JSON_TOKEN_OPEN_BRACKET; break;
+    case ']': kind = JSON_TOKEN_CLOSE_BRACKET; break;
+    case ',': kind = JSON_TOKEN_COMMA; break;
+    case ':': kind = JSON_TOKEN_COLON; break;
+    case '"': {
+        // NOTE(nic): the index guarantees the closing quote is the very next entry
+        assert(lexer->index_cursor < index->count);
+        size_t end = index->items[lexer->index_cursor++];
+        token->kind = JSON_TOKEN_STRING;
+        token->text = (String_View) { &lexer->content.data[loc + 1], end - loc - 1 };
+        lexer->cursor = end + 1;
+        return result;
+    }
+    default:
+        result = json_lexer_next_literal(lexer, token);
+        // NOTE(nic): the index only records where a run of literal characters starts, whatever the literal
+        // is not made of has to be caught here or the jump to the next entry would skip right over it
+        if (!result.failed && lexer->cursor < lexer->content.size) {
+            bool next_entry = lexer->index_cursor < index->count
+                && index->items[lexer->index_cursor] == lexer->cursor;
+            if (!next_entry && !isspace(lexer->content.data[lexer->cursor])) {
+                result.failed = true;
+                result.error = "invalid character";
+                result.error_loc = lexer->cursor;
+            }
+        }
+        return result;
+    }
+
+    token->kind = kind;
+    token->text = json_lexer_consume_chars(lexer, 1);
+    return result;
+}
+
+Json_Result json_lexer_scan(Json_Lexer *lexer, Json_Token *token) {
+    lexer->tokens_scanned += 1;
+    if (lexer->index != NULL) {
+        return json_lexer_next_indexed(lexer, token);
+    }
+
     json_lexer_consume_while(lexer, isspace);
     Json_Result result = {0};
     result.error_loc = lexer->cursor;
@@ -131,102 +525,364 @@ Json_Result json_lexer_next(Json_Lexer *lexer, Json_Token *token) {
             char ch = lexer->content.data[lexer->cursor];
             json_lexer_consume_chars(lexer, 1);
 
-            if (!escaped && ch == '\"') {
+            if (escaped) {
+                const char *error = json_check_escape(
+                    &lexer->content.data[lexer->cursor - 1],
+                    &lexer->content.data[lexer->content.size]);
+                if (error != NULL) {
+                    result.failed = true;
+                    result.error = error;
+                    result.error_loc = lexer->cursor - 2;
+                    return result;
+                }
+                escaped = false;
+                continue;
+            }
+            if (ch == '\"') {
                 break;
             }
-            escaped = (!escaped && ch == '\\');
+            escaped = (ch == '\\');
         }
         token->kind = JSON_TOKEN_STRING;
         token->text = (String_View) { begin, lexer->cursor - begin_cursor - 1 };
         return result;
     }
 
-    if (isalpha(ch)) {
-        String_View word = json_lexer_consume_while(lexer, isalnum);
-        for (size_t i = 0; i < json_keywords_count; ++i) {
-            if (sv_eq(word, json_keywords[i].sv)) {
-                token->kind = json_keywords[i].kind;
-                token->text = word;
+    return json_lexer_next_literal(lexer, token);
+}
+
+Json_Result json_lexer_next(Json_Lexer *lexer, Json_Token *token) {
+    if (lexer->has_lookahead) {
+        lexer->has_lookahead = false;
+        *token = lexer->lookahead;
+        return lexer->lookahead_result;
+    }
+    return json_lexer_scan(lexer, token);
+}
+
+Json_Result json_lexer_peek(Json_Lexer *lexer, Json_Token *token) {
+    if (!lexer->has_lookahead) {
+        lexer->lookahead_result = json_lexer_scan(lexer, &lexer->lookahead);
+        lexer->has_lookahead = true;
+    }
+    *token = lexer->lookahead;
+    return lexer->lookahead_result;
+}
+
+Json_Result json_lexer_next_partial(Json_Lexer *lexer, Json_Token *token, bool final, bool *incomplete) {
+    assert(lexer->index == NULL && !lexer->has_lookahead);
+    Json_Result result = {0};
+    *incomplete = false;
+
+    json_lexer_consume_while(lexer, isspace);
+    size_t begin = lexer->cursor;
+    String_View rest = { &lexer->content.data[begin], lexer->content.size - begin };
+    result.error_loc = begin;
+    token->loc = begin;
+    if (rest.size == 0) {
+        if (!final) {
+            *incomplete = true;
+            return result;
+        }
+        return json_lexer_next(lexer, token);
+    }
+
+    Json_Token_Kind kind;
+    switch (rest.data[0]) {
+    case '{': kind = JSON_TOKEN_OPEN_CURLY; break;
+    case '}': kind = JSON_TOKEN_CLOSE_CURLY; break;
+    case '[': kind = JSON_TOKEN_OPEN_BRACKET; break;
+    case ']': kind = JSON_TOKEN_CLOSE_BRACKET; break;
+    case ',': kind = JSON_TOKEN_COMMA; break;
+    case ':': kind = JSON_TOKEN_COLON; break;
+    case '"': {
+        size_t end = 1;
+        while (true) {
+            const char *quote = memchr(&rest.data[end], '"', rest.size - end);
+            if (quote == NULL) {
+                if (final) {
+                    // NOTE(nic): let the regular lexer report the unclosed string
+                    return json_lexer_next(lexer, token);
+                }
+                *incomplete = true;
                 return result;
             }
+            end = quote - rest.data;
+            size_t backslashes = 0;
+            while (rest.data[end - 1 - backslashes] == '\\') {
+                backslashes += 1;
+            }
+            end += 1;
+            if (backslashes % 2 == 0) {
+                break;
+            }
         }
-        result.failed = true;
-        result.error = "unknown word";
+        if (memchr(rest.data, '\n', end) != NULL) {
+            result.failed = true;
+            result.error = "unclosed string literal";
+            return result;
+        }
+        const char *backslash = memchr(&rest.data[1], '\\', end - 2);
+        while (backslash != NULL) {
+            const char *error = json_check_escape(backslash + 1, &rest.data[end - 1]);
+            if (error != NULL) {
+                result.failed = true;
+                result.error = error;
+                result.error_loc = begin + (backslash - rest.data);
+                return result;
+            }
+            backslash += (backslash[1] == 'u') ? 6 : 2;
+            backslash = memchr(backslash, '\\', &rest.data[end - 1] - backslash);
+        }
+        lexer->cursor = begin + end;
+        token->kind = JSON_TOKEN_STRING;
+        token->text = (String_View) { &rest.data[1], end - 2 };
         return result;
     }
-
-    // NOTE(nic): we do not validate integer and decimal literals
-    if (json_is_number_char(ch)) {
-        String_View number = json_lexer_consume_while(lexer, json_is_number_char);
-        token->kind = (sv_find(number, '.', NULL)) ? JSON_TOKEN_DECIMAL : JSON_TOKEN_INT64;
-        token->text = number;
-        return result;
+    default: {
+        if (!final) {
+            size_t size = 0;
+            while (size < rest.size && json_is_literal_char(rest.data[size])) {
+                size += 1;
+            }
+            if (size == rest.size) {
+                *incomplete = true;
+                return result;
+            }
+        }
+        return json_lexer_next_literal(lexer, token);
+    }
     }
 
-    result.failed = true;
-    result.error = "invalid character";
+    token->kind = kind;
+    token->text = json_lexer_consume_chars(lexer, 1);
     return result;
 }
 
-Json_Result json_lexer_peek(Json_Lexer *lexer, Json_Token *token) {
-    size_t save_cursor = lexer->cursor;
-    Json_Result result = json_lexer_next(lexer, token);
-    lexer->cursor = save_cursor;
-    return result;
+// NOTE(nic): grows by doubling like arena_da_append does, but moves the old bytes with memcpy.
+// Dumps of big trees grow the buffer many times over, and the byte by byte copy used to dominate.
+void json_write_reserve(Arena *arena, String *out, size_t extra) {
+    if (out->count + extra <= out->capacity) {
+        return;
+    }
+    size_t capacity = (out->capacity > 0) ? out->capacity : ARENA_DA_INIT_CAP;
+    while (capacity < out->count + extra) {
+        capacity *= 2;
+    }
+    char *items = arena_alloc(arena, capacity);
+    if (out->count > 0) {
+        memcpy(items, out->items, out->count);
+    }
+    out->items = items;
+    out->capacity = capacity;
 }
 
-void json_print_dict(Json_Dict *dict) {
-    printf("{");
+void json_write_bytes(Arena *arena, String *out, const char *data, size_t size) {
+    json_write_reserve(arena, out, size);
+    if (size > 0) {
+        memcpy(out->items + out->count, data, size);
+    }
+    out->count += size;
+}
+
+void json_write_char(Arena *arena, String *out, char ch) {
+    json_write_reserve(arena, out, 1);
+    out->items[out->count++] = ch;
+}
+
+void json_write_indent(Arena *arena, String *out, Json_Write_Mode mode, size_t depth) {
+    if (mode != JSON_WRITE_PRETTY) {
+        return;
+    }
+    size_t spaces = depth*JSON_WRITE_INDENT;
+    json_write_reserve(arena, out, spaces + 1);
+    out->items[out->count++] = '\n';
+    memset(out->items + out->count, ' ', spaces);
+    out->count += spaces;
+}
+
+// NOTE(nic): quotes, backslashes and control characters are escaped, everything else
+// goes out untouched in runs so valid UTF-8 stays valid
+void json_write_string(Arena *arena, String *out, String_View sv) {
+    static const char hex[] = "0123456789abcdef";
+    json_write_char(arena, out, '"');
+    size_t run = 0;
+    for (size_t i = 0; i < sv.size; ++i) {
+        unsigned char ch = (unsigned char)sv.data[i];
+        if (ch >= 0x20 && ch != '"' && ch != '\\') {
+            continue;
+        }
+        json_write_bytes(arena, out, sv.data + run, i - run);
+        run = i + 1;
+
+        char escape[6] = { '\\', 0 };
+        size_t escape_size = 2;
+        switch (ch) {
+        case '"': escape[1] = '"'; break;
+        case '\\': escape[1] = '\\'; break;
+        case '\b': escape[1] = 'b'; break;
+        case '\f': escape[1] = 'f'; break;
+        case '\n': escape[1] = 'n'; break;
+        case '\r': escape[1] = 'r'; break;
+        case '\t': escape[1] = 't'; break;
+        default: {
+            escape[1] = 'u';
+            escape[2] = '0';
+            escape[3] = '0';
+            escape[4] = hex[ch >> 4];
+            escape[5] = hex[ch & 0xf];
+            escape_size = 6;
+        }
+        }
+        json_write_bytes(arena, out, escape, escape_size);
+    }
+    json_write_bytes(arena, out, sv.data + run, sv.size - run);
+    json_write_char(arena, out, '"');
+}
+
+void json_write_int64(Arena *arena, String *out, int64_t n) {
+    char digits[20];
+    size_t count = 0;
+    // NOTE(nic): works on the magnitude as unsigned, so INT64_MIN needs no special case
+    uint64_t value = (n < 0) ? -(uint64_t)n : (uint64_t)n;
+    do {
+        digits[sizeof(digits) - ++count] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    if (n < 0) {
+        json_write_char(arena, out, '-');
+    }
+    json_write_bytes(arena, out, digits + sizeof(digits) - count, count);
+}
+
+// NOTE(nic): shortest of %.15g and %.17g that reads back as the same double, with a `.0` added to
+// whole numbers so they stay decimals. JSON has no infinities or NaNs, those become null.
+void json_write_decimal(Arena *arena, String *out, double n) {
+    if (isnan(n) || isinf(n)) {
+        json_write_bytes(arena, out, "null", 4);
+        return;
+    }
+    char text[32];
+    int size = snprintf(text, sizeof(text), "%.15g", n);
+    if (strtod(text, NULL) != n) {
+        size = snprintf(text, sizeof(text), "%.17g", n);
+    }
+    json_write_bytes(arena, out, text, size);
+    if (strcspn(text, ".eEn") == (size_t)size) {
+        json_write_bytes(arena, out, ".0", 2);
+    }
+}
+
+void json_write_obj_at(Arena *arena, String *out, Json_Object *obj, Json_Write_Mode mode, size_t depth);
+
+void json_write_dict_at(Arena *arena, String *out, Json_Dict *dict, Json_Write_Mode mode, size_t depth) {
+    json_write_char(arena, out, '{');
     for (size_t i = 0; i < dict->count; ++i) {
-        json_print_obj(&dict->items[i].key);
-        printf(": ");
-        json_print_obj(&dict->items[i].value);
-        if (i < dict->count - 1) {
-            printf(", ");
+        if (i > 0) {
+            json_write_char(arena, out, ',');
+        }
+        json_write_indent(arena, out, mode, depth + 1);
+        json_write_obj_at(arena, out, &dict->items[i].key, mode, depth + 1);
+        json_write_char(arena, out, ':');
+        if (mode == JSON_WRITE_PRETTY) {
+            json_write_char(arena, out, ' ');
         }
+        json_write_obj_at(arena, out, &dict->items[i].value, mode, depth + 1);
     }
-    printf("}");
+    if (dict->count > 0) {
+        json_write_indent(arena, out, mode, depth);
+    }
+    json_write_char(arena, out, '}');
 }
 
-void json_print_array(Json_Array *array) {
-    printf("[");
+void json_write_array_at(Arena *arena, String *out, Json_Array *array, Json_Write_Mode mode, size_t depth) {
+    json_write_char(arena, out, '[');
     for (size_t i = 0; i < array->count; ++i) {
-        json_print_obj(&array->items[i]);
-        if (i < array->count - 1) {
-            printf(", ");
+        if (i > 0) {
+            json_write_char(arena, out, ',');
         }
+        json_write_indent(arena, out, mode, depth + 1);
+        json_write_obj_at(arena, out, &array->items[i], mode, depth + 1);
     }
-    printf("]");
+    if (array->count > 0) {
+        json_write_indent(arena, out, mode, depth);
+    }
+    json_write_char(arena, out, ']');
 }
 
-void json_print_obj(Json_Object *obj) {
+void json_write_obj_at(Arena *arena, String *out, Json_Object *obj, Json_Write_Mode mode, size_t depth) {
     switch (obj->kind) {
     case JSON_OBJ_NULL:
-        printf("null");
+        json_write_bytes(arena, out, "null", 4);
         break;
     case JSON_OBJ_DICT:
-        json_print_dict(&obj->as.dict);
+        json_write_dict_at(arena, out, &obj->as.dict, mode, depth);
         break;
     case JSON_OBJ_ARRAY:
-        json_print_array(&obj->as.array);
+        json_write_array_at(arena, out, &obj->as.array, mode, depth);
         break;
     case JSON_OBJ_BOOLEAN:
-        printf("%s", (obj->as.boolean) ? "true" : "false");
+        if (obj->as.boolean) {
+            json_write_bytes(arena, out, "true", 4);
+        } else {
+            json_write_bytes(arena, out, "false", 5);
+        }
         break;
     case JSON_OBJ_INT64:
-        printf("%ld", obj->as.int64);
+        json_write_int64(arena, out, obj->as.int64);
         break;
     case JSON_OBJ_DECIMAL:
-        printf("%lf", obj->as.decimal);
+        json_write_decimal(arena, out, obj->as.decimal);
         break;
     case JSON_OBJ_STRING:
-        printf("\"%.*s\"", (int)obj->as.string.count, obj->as.string.items);
+        if (obj->flags & JSON_STRING_ESCAPED) {
+            // NOTE(nic): still the source text, which is escaped already
+            json_write_char(arena, out, '"');
+            json_write_bytes(arena, out, obj->as.string.items, obj->as.string.count);
+            json_write_char(arena, out, '"');
+        } else {
+            json_write_string(arena, out, (String_View) { obj->as.string.items, obj->as.string.count });
+        }
         break;
     default:
         assert(0 && "unreachable");
     }
 }
 
+void json_write_obj(Arena *arena, String *out, Json_Object *obj, Json_Write_Mode mode) {
+    json_write_obj_at(arena, out, obj, mode, 0);
+}
+
+void json_write_dict(Arena *arena, String *out, Json_Dict *dict, Json_Write_Mode mode) {
+    json_write_dict_at(arena, out, dict, mode, 0);
+}
+
+void json_write_array(Arena *arena, String *out, Json_Array *array, Json_Write_Mode mode) {
+    json_write_array_at(arena, out, array, mode, 0);
+}
+
+// NOTE(nic): the printers write into a scratch arena and hand stdout the whole thing at once
+#define JSON_PRINT(write, value)                                \
+    do {                                                        \
+        Arena scratch = {0};                                    \
+        String out = {0};                                       \
+        write(&scratch, &out, (value), JSON_WRITE_PRETTY);      \
+        fwrite(out.items, 1, out.count, stdout);                \
+        arena_free(&scratch);                                   \
+    } while (0)
+
+void json_print_dict(Json_Dict *dict) {
+    JSON_PRINT(json_write_dict, dict);
+}
+
+void json_print_array(Json_Array *array) {
+    JSON_PRINT(json_write_array, array);
+}
+
+void json_print_obj(Json_Object *obj) {
+    JSON_PRINT(json_write_obj, obj);
+}
+
 Json_Result json_parse_expect(Json_Lexer *lexer, Json_Token_Kind kind) {
     Json_Token token = {0};
     Json_Result result = json_lexer_next(lexer, &token);
@@ -240,38 +896,349 @@ Json_Result json_parse_expect(Json_Lexer *lexer, Json_Token_Kind kind) {
     return result;
 }
 
+size_t json_utf8_encode(uint32_t code_point, char *out) {
+    if (code_point < 0x80) {
+        out[0] = (char)code_point;
+        return 1;
+    }
+    if (code_point < 0x800) {
+        out[0] = (char)(0xC0 | (code_point >> 6));
+        out[1] = (char)(0x80 | (code_point & 0x3F));
+        return 2;
+    }
+    if (code_point < 0x10000) {
+        out[0] = (char)(0xE0 | (code_point >> 12));
+        out[1] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (code_point & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (code_point >> 18));
+    out[1] = (char)(0x80 | ((code_point >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (code_point & 0x3F));
+    return 4;
+}
+
+bool json_utf8_validate(String_View sv, size_t *error_index) {
+    const uint8_t *data = (const uint8_t *)sv.data;
+    size_t i = 0;
+    while (i < sv.size) {
+        // NOTE(nic): almost everything is ASCII, so skip it a whole block at a time
+#if JSON_X86_SIMD
+        while (i + 16 <= sv.size &&
+               _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)&data[i])) == 0)
+        {
+            i += 16;
+        }
+#else
+        while (i + 8 <= sv.size) {
+            uint64_t word;
+            memcpy(&word, &data[i], sizeof(word));
+            if ((word & 0x8080808080808080ull) != 0) {
+                break;
+            }
+            i += 8;
+        }
+#endif
+        if (i >= sv.size) {
+            break;
+        }
+        uint8_t ch = data[i];
+        if (ch < 0x80) {
+            i += 1;
+            continue;
+        }
+
+        size_t size;
+        uint32_t code_point;
+        uint32_t min_code_point;
+        if ((ch & 0xE0) == 0xC0) {
+            size = 2; code_point = ch & 0x1F; min_code_point = 0x80;
+        } else if ((ch & 0xF0) == 0xE0) {
+            size = 3; code_point = ch & 0x0F; min_code_point = 0x800;
+        } else if ((ch & 0xF8) == 0xF0) {
+            size = 4; code_point = ch & 0x07; min_code_point = 0x10000;
+        } else {
+            goto invalid;
+        }
+        if (i + size > sv.size) {
+            goto invalid;
+        }
+        for (size_t j = 1; j < size; ++j) {
+            if ((data[i + j] & 0xC0) != 0x80) {
+                goto invalid;
+            }
+            code_point = (code_point << 6) | (data[i + j] & 0x3F);
+        }
+        if (code_point < min_code_point || code_point > 0x10FFFF ||
+            (code_point >= 0xD800 && code_point <= 0xDFFF))
+        {
+            goto invalid;
+        }
+        i += size;
+    }
+    return true;
+
+invalid:
+    if (error_index != NULL) {
+        *error_index = i;
+    }
+    return false;
+}
+
+// NOTE(nic): RFC 8259 escapes, unpaired surrogates become U+FFFD.
+// Escape free runs are found with memchr and copied with memcpy, both of which libc vectorizes.
 Json_Result json_solve_special_characters(Arena *arena, String *str, String_View sv, size_t loc) {
     Json_Result result = {0};
-    size_t backslash_index;
-    while (sv_find(sv, '\\', &backslash_index)) {
-        arena_da_append_many(arena, str, sv.data, backslash_index);
-        assert(backslash_index + 1 < sv.size);
-        char special_ch = sv.data[backslash_index + 1];
+
+    // NOTE(nic): unescaping never makes a string longer (\uXXXX is 6 bytes for at most 3,
+    // a surrogate pair is 12 bytes for 4), so one reservation is enough
+    if (str->count + sv.size > str->capacity) {
+        size_t capacity = str->count + sv.size;
+        str->items = arena_realloc(arena, str->items, str->capacity, capacity);
+        str->capacity = capacity;
+    }
+
+    char *out = str->items + str->count;
+    const char *curr = sv.data;
+    const char *end = sv.data + sv.size;
+    while (curr < end) {
+        const char *backslash = memchr(curr, '\\', end - curr);
+        size_t run = ((backslash != NULL) ? backslash : end) - curr;
+        memcpy(out, curr, run);
+        out += run;
+        curr += run;
+        if (backslash == NULL) {
+            break;
+        }
+
+        result.error_loc = loc + (curr - sv.data);
+        if (curr + 1 >= end) {
+            result.failed = true;
+            result.error = "unterminated escape sequence";
+            return result;
+        }
+        char special_ch = curr[1];
+        curr += 2;
         switch (special_ch) {
-        case '/': str_append_char(arena, str, '/'); break;
-        case 'f': str_append_char(arena, str, '\f'); break;
-        case 'r': str_append_char(arena, str, '\r'); break;
-        case 'b': str_append_char(arena, str, '\b'); break;
-        case 'n': str_append_char(arena, str, '\n'); break;
-        case 't': str_append_char(arena, str, '\t'); break;
-        case '0': str_append_char(arena, str, '\0'); break;
-        case '\'': str_append_char(arena, str, '\''); break;
-        case '\"': str_append_char(arena, str, '\"'); break;
-        case '\\': str_append_char(arena, str, '\\'); break;
+        case '/': *out++ = '/'; break;
+        case 'f': *out++ = '\f'; break;
+        case 'r': *out++ = '\r'; break;
+        case 'b': *out++ = '\b'; break;
+        case 'n': *out++ = '\n'; break;
+        case 't': *out++ = '\t'; break;
+        case '\"': *out++ = '\"'; break;
+        case '\\': *out++ = '\\'; break;
+        case 'u': {
+            uint32_t code_point;
+            if (end - curr < 4 || !json_parse_hex4(curr, &code_point)) {
+                result.failed = true;
+                result.error = "invalid unicode escape";
+                return result;
+            }
+            curr += 4;
+            if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+                uint32_t low;
+                if (end - curr >= 6 && curr[0] == '\\' && curr[1] == 'u' &&
+                    json_parse_hex4(curr + 2, &low) && low >= 0xDC00 && low <= 0xDFFF)
+                {
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                    curr += 6;
+                } else {
+                    code_point = 0xFFFD;
+                }
+            } else if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+                code_point = 0xFFFD;
+            }
+            out += json_utf8_encode(code_point, out);
+        } break;
         default:
             result.failed = true;
             result.error = "invalid special character";
-            result.error_loc = loc;
             return result;
         }
-        sv.data = sv.data + backslash_index + 2;
-        sv.size = sv.size - backslash_index - 2;
     }
-    arena_da_append_many(arena, str, sv.data, sv.size);
+
+    str->count = out - str->items;
+    result.error_loc = 0;
     return result;
 }
 
-Json_Result json_parse_object(Arena *arena, Json_Lexer *lexer, Json_Object *object) {
+// NOTE(nic): capacity of zero marks the bytes as not owned, str_append_* copy them (see str_own) before appending
+String json_string_borrow(String_View sv) {
+    String str = {0};
+    str.items = (char *)sv.data;
+    str.count = sv.size;
+    str.capacity = 0;
+    return str;
+}
+
+void json_string_from_token(Json_Token *token, Json_Object *object) {
+    object->kind = JSON_OBJ_STRING;
+    object->as.string = json_string_borrow(token->text);
+    object->flags = sv_find(token->text, '\\', NULL) ? JSON_STRING_ESCAPED : 0;
+}
+
+Json_Result json_string_decode(Arena *arena, Json_Object *string) {
+    assert(string->kind == JSON_OBJ_STRING);
+    Json_Result result = {0};
+    if (string->flags & JSON_STRING_CHECKED) {
+        return result;
+    }
+
+    // NOTE(nic): escapes are plain ASCII, so checking the raw text covers the decoded one as well
+    String_View raw = { string->as.string.items, string->as.string.count };
+    if (!json_utf8_validate(raw, &result.error_loc)) {
+        result.failed = true;
+        result.error = "invalid utf-8";
+        return result;
+    }
+
+    if (string->flags & JSON_STRING_ESCAPED) {
+        String decoded = str_with_cap(arena, raw.size);
+        result = json_solve_special_characters(arena, &decoded, raw, 0);
+        if (result.failed) {
+            return result;
+        }
+        string->as.string = decoded;
+    }
+    string->flags = JSON_STRING_CHECKED;
+    return result;
+}
+
+// NOTE(nic): strings with broken escapes or broken UTF-8 are returned as they appear in the input
+String *json_dict_get_decoded_string(Arena *arena, Json_Dict *dict, Json_Object key) {
+    Json_Object *value = json_dict_get(dict, key);
+    if (value == NULL) {
+        return NULL;
+    }
+    assert(value->kind == JSON_OBJ_STRING);
+    (void)json_string_decode(arena, value);
+    return &value->as.string;
+}
+
+// NOTE(nic): FNV-1a
+uint32_t json_hash(const char *data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (uint8_t)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void json_interner_grow(Arena *arena, Json_Interner *interner) {
+    size_t capacity = (interner->capacity == 0) ? 64 : interner->capacity * 2;
+    Json_Interned *items = arena_alloc(arena, capacity * sizeof(*items));
+    memset(items, 0, capacity * sizeof(*items));
+    for (size_t i = 0; i < interner->capacity; ++i) {
+        Json_Interned *old = &interner->items[i];
+        if (old->str.items == NULL) {
+            continue;
+        }
+        size_t slot = old->hash & (capacity - 1);
+        while (items[slot].str.items != NULL) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        items[slot] = *old;
+    }
+    interner->items = items;
+    interner->capacity = capacity;
+}
+
+String *json_intern(Arena *arena, Json_Interner *interner, String_View raw, size_t loc, Json_Result *result) {
+    *result = (Json_Result) {0};
+    if (sv_find(raw, '\\', NULL)) {
+        // NOTE(nic): escaped keys are rare enough to not be worth sharing
+        String *str = arena_alloc(arena, sizeof(*str));
+        *str = str_with_cap(arena, raw.size);
+        *result = json_solve_special_characters(arena, str, raw, loc);
+        return str;
+    }
+
+    if ((interner->count + 1) * 2 > interner->capacity) {
+        json_interner_grow(arena, interner);
+    }
+
+    uint32_t hash = json_hash(raw.data, raw.size);
+    size_t slot = hash & (interner->capacity - 1);
+    while (interner->items[slot].str.items != NULL) {
+        Json_Interned *interned = &interner->items[slot];
+        if (interned->hash == hash && sv_eq(raw, (String_View) { interned->str.items, interned->str.count })) {
+            return &interned->str;
+        }
+        slot = (slot + 1) & (interner->capacity - 1);
+    }
+
+    Json_Interned *interned = &interner->items[slot];
+    interned->hash = hash;
+    interned->str = json_string_borrow(raw);
+    interner->count += 1;
+    return &interned->str;
+}
+
+Json_Object json_intern_key(Arena *arena, Json_Interner *interner, const char *cstr) {
+    String_View key = SV(cstr);
+    if (sv_find(key, '\\', NULL)) {
+        // NOTE(nic): the table holds keys as they are written in the input, a backslash there starts an escape
+        return json_obj_string(arena, cstr);
+    }
+    Json_Result result = {0};
+    Json_Object obj = {0};
+    obj.kind = JSON_OBJ_STRING;
+    obj.as.string = *json_intern(arena, interner, key, 0, &result);
+    return obj;
+}
+
+void json_dict_build_index(Arena *arena, Json_Dict *dict) {
+    size_t capacity = 16;
+    while (capacity < dict->count * 2) {
+        capacity *= 2;
+    }
+    Json_Dict_Index *index = arena_alloc(arena, sizeof(*index));
+    index->capacity = capacity;
+    index->slots = arena_alloc(arena, capacity * sizeof(*index->slots));
+    memset(index->slots, 0, capacity * sizeof(*index->slots));
+
+    for (size_t i = 0; i < dict->count; ++i) {
+        Json_Object *key = &dict->items[i].key;
+        if (key->kind != JSON_OBJ_STRING) {
+            // NOTE(nic): hand built dicts may use any kind of key, those keep the linear lookup
+            return;
+        }
+        uint32_t hash = json_hash(key->as.string.items, key->as.string.count);
+        size_t slot = hash & (capacity - 1);
+        while (index->slots[slot].index != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        index->slots[slot].hash = hash;
+        index->slots[slot].index = (uint32_t)i + 1;
+    }
+    dict->index = index;
+}
+
+Json_Result json_parse_key(Arena *arena, Json_Lexer *lexer, Json_Object *key) {
+    if (lexer->interner == NULL) {
+        return json_parse_value(arena, lexer, key);
+    }
+
+    Json_Token token = {0};
+    Json_Result result = json_lexer_next(lexer, &token);
+    if (result.failed) {
+        return result;
+    }
+    if (token.kind != JSON_TOKEN_STRING) {
+        result.failed = true;
+        result.error = "expected string key";
+        result.error_loc = token.loc;
+        return result;
+    }
+    key->kind = JSON_OBJ_STRING;
+    key->as.string = *json_intern(arena, lexer->interner, token.text, token.loc + 1, &result);
+    return result;
+}
+
+Json_Result json_parse_value(Arena *arena, Json_Lexer *lexer, Json_Object *object) {
     Json_Token token = {0};
     Json_Result result = json_lexer_next(lexer, &token);
     if (result.failed) {
@@ -280,6 +1247,8 @@ Json_Result json_parse_object(Arena *arena, Json_Lexer *lexer, Json_Object *obje
     switch (token.kind) {
     case JSON_TOKEN_OPEN_CURLY: {
         object->kind = JSON_OBJ_DICT;
+        Json_Pair_Stack *pairs = &lexer->stack->pairs;
+        size_t base = pairs->count;
         while (true) {
             Json_Token peek = {0};
             Json_Result result = json_lexer_peek(lexer, &peek);
@@ -291,7 +1260,7 @@ Json_Result json_parse_object(Arena *arena, Json_Lexer *lexer, Json_Object *obje
                 break;
             }
             Json_Key_Value_Pair pair = {0};
-            result = json_parse_object(arena, lexer, &pair.key);
+            result = json_parse_key(arena, lexer, &pair.key);
             if (result.failed) {
                 return result;
             }
@@ -299,11 +1268,11 @@ Json_Result json_parse_object(Arena *arena, Json_Lexer *lexer, Json_Object *obje
             if (result.failed) {
                 return result;
             }
-            result = json_parse_object(arena, lexer, &pair.value);
+            result = json_parse_value(arena, lexer, &pair.value);
             if (result.failed) {
                 return result;
             }
-            arena_da_append(arena, &object->as.dict, pair);
+            arena_da_append(&lexer->stack->arena, pairs, pair);
             result = json_lexer_peek(lexer, &peek);
             if (result.failed) {
                 return result;
@@ -317,9 +1286,20 @@ Json_Result json_parse_object(Arena *arena, Json_Lexer *lexer, Json_Object *obje
                 return result;
             }
         }
+        object->as.dict.count = (uint32_t)(pairs->count - base);
+        object->as.dict.capacity = object->as.dict.count;
+        if (object->as.dict.count > 0) {
+            object->as.dict.items = arena_memdup(arena, &pairs->items[base], object->as.dict.count * sizeof(*pairs->items));
+        }
+        pairs->count = base;
+        if (object->as.dict.count >= JSON_DICT_INDEX_MIN_COUNT) {
+            json_dict_build_index(arena, &object->as.dict);
+        }
     } break;
     case JSON_TOKEN_OPEN_BRACKET: {
         object->kind = JSON_OBJ_ARRAY;
+        Json_Object_Stack *items = &lexer->stack->items;
+        size_t base = items->count;
         while (true) {
             Json_Token peek = {0};
             Json_Result result = json_lexer_peek(lexer, &peek);
@@ -331,11 +1311,11 @@ Json_Result json_parse_object(Arena *arena, Json_Lexer *lexer, Json_Object *obje
                 break;
             }
             Json_Object item = {0};
-            result = json_parse_object(arena, lexer, &item);
+            result = json_parse_value(arena, lexer, &item);
             if (result.failed) {
                 return result;
             }
-            arena_da_append(arena, &object->as.array, item);
+            arena_da_append(&lexer->stack->arena, items, item);
             result = json_lexer_peek(lexer, &peek);
             if (result.failed) {
                 return result;
@@ -349,6 +1329,12 @@ Json_Result json_parse_object(Arena *arena, Json_Lexer *lexer, Json_Object *obje
                 return result;
             }
         }
+        object->as.array.count = items->count - base;
+        object->as.array.capacity = object->as.array.count;
+        if (object->as.array.count > 0) {
+            object->as.array.items = arena_memdup(arena, &items->items[base], object->as.array.count * sizeof(*items->items));
+        }
+        items->count = base;
     } break;
     case JSON_TOKEN_TRUE: {
         object->kind = JSON_OBJ_BOOLEAN;
@@ -370,9 +1356,7 @@ Json_Result json_parse_object(Arena *arena, Json_Lexer *lexer, Json_Object *obje
         object->as.decimal = sv_to_decimal(token.text);
     } break;
     case JSON_TOKEN_STRING: {
-        object->kind = JSON_OBJ_STRING;
-        result = json_solve_special_characters(
-            arena, &object->as.string, token.text, token.loc);
+        json_string_from_token(&token, object);
     } break;
     case JSON_TOKEN_END: {
         result.failed = true;
@@ -388,12 +1372,192 @@ Json_Result json_parse_object(Arena *arena, Json_Lexer *lexer, Json_Object *obje
     return result;
 }
 
+// NOTE(nic): a lexer without a stack gets one for the duration of the parse
+Json_Result json_parse_object(Arena *arena, Json_Lexer *lexer, Json_Object *object) {
+    if (lexer->stack != NULL) {
+        return json_parse_value(arena, lexer, object);
+    }
+    Json_Parse_Stack stack = {0};
+    lexer->stack = &stack;
+    Json_Result result = json_parse_value(arena, lexer, object);
+    lexer->stack = NULL;
+    arena_free(&stack.arena);
+    return result;
+}
+
 Json_Result json_parse(Arena *arena, Json_Object *object, const char *data, size_t size) {
+    Json_Interner interner = {0};
+    return json_parse_interned(arena, &interner, object, data, size);
+}
+
+Json_Result json_parse_interned(Arena *arena, Json_Interner *interner, Json_Object *object, const char *data, size_t size) {
     String_View view = { data, size };
-    Json_Lexer lexer = { view, 0 };
+    Json_Lexer lexer = { .content = view, .interner = interner };
+    json_lexer_attach_index(arena, &lexer);
     return json_parse_object(arena, &lexer, object);
 }
 
+Json_Result json_sax_key(Arena *arena, Json_Token *token, String *key) {
+    Json_Result result = {0};
+    if (!sv_find(token->text, '\\', NULL)) {
+        *key = json_string_borrow(token->text);
+        return result;
+    }
+    *key = str_with_cap(arena, token->text.size);
+    return json_solve_special_characters(arena, key, token->text, token->loc + 1);
+}
+
+#define JSON_SAX_CALL(stopped, callback, args)                          \
+    do {                                                                \
+        if ((callback) != NULL && (callback) args == JSON_SAX_STOP) {   \
+            *(stopped) = true;                                          \
+            return result;                                              \
+        }                                                               \
+    } while (0)
+
+Json_Result json_sax_parse_value(Arena *arena, Json_Lexer *lexer, Json_Sax *sax, bool *stopped) {
+    Json_Token token = {0};
+    Json_Result result = json_lexer_next(lexer, &token);
+    if (result.failed) {
+        return result;
+    }
+    switch (token.kind) {
+    case JSON_TOKEN_OPEN_CURLY: {
+        JSON_SAX_CALL(stopped, sax->start_object, (sax->user_data));
+        while (true) {
+            Json_Token peek = {0};
+            result = json_lexer_peek(lexer, &peek);
+            if (result.failed) {
+                return result;
+            }
+            if (peek.kind == JSON_TOKEN_CLOSE_CURLY) {
+                json_lexer_next(lexer, &peek);
+                break;
+            }
+            json_lexer_next(lexer, &peek);
+            if (peek.kind != JSON_TOKEN_STRING) {
+                result.failed = true;
+                result.error = "expected string key";
+                result.error_loc = peek.loc;
+                return result;
+            }
+            String key = {0};
+            result = json_sax_key(arena, &peek, &key);
+            if (result.failed) {
+                return result;
+            }
+            JSON_SAX_CALL(stopped, sax->key, (sax->user_data, &key));
+            result = json_parse_expect(lexer, JSON_TOKEN_COLON);
+            if (result.failed) {
+                return result;
+            }
+            result = json_sax_parse_value(arena, lexer, sax, stopped);
+            if (result.failed || *stopped) {
+                return result;
+            }
+            result = json_lexer_peek(lexer, &peek);
+            if (result.failed) {
+                return result;
+            }
+            if (peek.kind == JSON_TOKEN_COMMA) {
+                json_lexer_next(lexer, &peek);
+            } else if (peek.kind != JSON_TOKEN_CLOSE_CURLY) {
+                result.failed = true;
+                result.error = "unexpected token";
+                result.error_loc = peek.loc;
+                return result;
+            }
+        }
+        JSON_SAX_CALL(stopped, sax->end_object, (sax->user_data));
+    } break;
+    case JSON_TOKEN_OPEN_BRACKET: {
+        JSON_SAX_CALL(stopped, sax->start_array, (sax->user_data));
+        while (true) {
+            Json_Token peek = {0};
+            result = json_lexer_peek(lexer, &peek);
+            if (result.failed) {
+                return result;
+            }
+            if (peek.kind == JSON_TOKEN_CLOSE_BRACKET) {
+                json_lexer_next(lexer, &peek);
+                break;
+            }
+            result = json_sax_parse_value(arena, lexer, sax, stopped);
+            if (result.failed || *stopped) {
+                return result;
+            }
+            result = json_lexer_peek(lexer, &peek);
+            if (result.failed) {
+                return result;
+            }
+            if (peek.kind == JSON_TOKEN_COMMA) {
+                json_lexer_next(lexer, &peek);
+            } else if (peek.kind != JSON_TOKEN_CLOSE_BRACKET) {
+                result.failed = true;
+                result.error = "unexpected token";
+                result.error_loc = peek.loc;
+                return result;
+            }
+        }
+        JSON_SAX_CALL(stopped, sax->end_array, (sax->user_data));
+    } break;
+    case JSON_TOKEN_TRUE:
+    case JSON_TOKEN_FALSE:
+    case JSON_TOKEN_NULL:
+    case JSON_TOKEN_INT64:
+    case JSON_TOKEN_DECIMAL:
+    case JSON_TOKEN_STRING: {
+        Json_Object value = {0};
+        switch (token.kind) {
+        case JSON_TOKEN_TRUE:
+        case JSON_TOKEN_FALSE:
+            value.kind = JSON_OBJ_BOOLEAN;
+            value.as.boolean = token.kind == JSON_TOKEN_TRUE;
+            break;
+        case JSON_TOKEN_NULL:
+            value.kind = JSON_OBJ_NULL;
+            break;
+        case JSON_TOKEN_INT64:
+            value.kind = JSON_OBJ_INT64;
+            value.as.int64 = sv_to_int64(token.text);
+            break;
+        case JSON_TOKEN_DECIMAL:
+            value.kind = JSON_OBJ_DECIMAL;
+            value.as.decimal = sv_to_decimal(token.text);
+            break;
+        default:
+            json_string_from_token(&token, &value);
+        }
+        JSON_SAX_CALL(stopped, sax->scalar, (sax->user_data, &value));
+    } break;
+    case JSON_TOKEN_END: {
+        result.failed = true;
+        result.error = "unexpected end of json";
+        result.error_loc = token.loc;
+    } break;
+    default: {
+        result.failed = true;
+        result.error = "unexpected token";
+        result.error_loc = token.loc;
+    }
+    }
+    return result;
+}
+
+#undef JSON_SAX_CALL
+
+Json_Result json_sax_parse(Arena *arena, Json_Sax *sax, const char *data, size_t size, bool *stopped) {
+    String_View view = { data, size };
+    Json_Lexer lexer = { .content = view };
+    json_lexer_attach_index(arena, &lexer);
+    bool stopped_ = false;
+    if (stopped == NULL) {
+        stopped = &stopped_;
+    }
+    *stopped = false;
+    return json_sax_parse_value(arena, &lexer, sax, stopped);
+}
+
 Json_Object json_obj_string(Arena *arena, const char *cstr) {
     Json_Object obj = {0};
     String str = str_with_cap(arena, strlen(cstr));
@@ -419,16 +1583,40 @@ bool json_obj_eq(Json_Object *a, Json_Object *b) {
     }
 }
 
-Json_Object *json_dict_get(Json_Dict *dict, Json_Object key) {
+Json_Key_Value_Pair *json_dict_find_pair(Json_Dict *dict, Json_Object *key) {
+    if (dict->index != NULL && key->kind == JSON_OBJ_STRING) {
+        String *str = &key->as.string;
+        Json_Dict_Index *index = dict->index;
+        uint32_t hash = json_hash(str->items, str->count);
+        size_t slot = hash & (index->capacity - 1);
+        while (index->slots[slot].index != 0) {
+            if (index->slots[slot].hash == hash) {
+                Json_Key_Value_Pair *pair = &dict->items[index->slots[slot].index - 1];
+                // NOTE(nic): keys interned in the table of the parse (json_intern_key) make the pointer check
+                // succeed without touching the bytes, any other key is compared byte by byte
+                if (pair->key.as.string.items == str->items || str_eq(&pair->key.as.string, str)) {
+                    return pair;
+                }
+            }
+            slot = (slot + 1) & (index->capacity - 1);
+        }
+        return NULL;
+    }
+
     for (size_t i = 0; i < dict->count; ++i) {
         Json_Key_Value_Pair *pair = &dict->items[i];
-        if (json_obj_eq(&pair->key, &key)) {
-            return &pair->value;
+        if (json_obj_eq(&pair->key, key)) {
+            return pair;
         }
     }
     return NULL;
 }
 
+Json_Object *json_dict_get(Json_Dict *dict, Json_Object key) {
+    Json_Key_Value_Pair *pair = json_dict_find_pair(dict, &key);
+    return (pair != NULL) ? &pair->value : NULL;
+}
+
 Json_Object *json_array_get(Json_Array *array, size_t index) {
     assert(index < array->count);
     return &array->items[index];
@@ -436,14 +1624,12 @@ Json_Object *json_array_get(Json_Array *array, size_t index) {
 
 #define X(sufix, kind_, type)                                       \
     type *json_dict_get_##sufix(Json_Dict *dict, Json_Object key) { \
-        for (size_t i = 0; i < dict->count; ++i) {                  \
-            Json_Key_Value_Pair *pair = &dict->items[i];            \
-            if (json_obj_eq(&pair->key, &key)) {                    \
-                assert(pair->value.kind == kind_);                  \
-                return &pair->value.as.sufix;                       \
-            }                                                       \
+        Json_Key_Value_Pair *pair = json_dict_find_pair(dict, &key);\
+        if (pair == NULL) {                                         \
+            return NULL;                                            \
         }                                                           \
-        return NULL;                                                \
+        assert(pair->value.kind == kind_);                          \
+        return &pair->value.as.sufix;                               \
     }                                                               \
     type *json_array_get_##sufix(Json_Array *array, size_t index) { \
         assert(index < array->count);                               \
@@ -30,13 +30,28 @@ typedef enum {
     JSON_OBJ_STRING,
 } Json_Object_Kind;
 
+// NOTE(nic): dicts with at least this many keys get a hash index when they are parsed
+#define JSON_DICT_INDEX_MIN_COUNT 8
+
 typedef struct Json_Object Json_Object;
 typedef struct Json_Key_Value_Pair Json_Key_Value_Pair;
 
+typedef struct {
+    uint32_t hash;
+    uint32_t index; // NOTE(nic): index of the pair plus one, zero marks an empty slot
+} Json_Dict_Slot;
+
+typedef struct {
+    Json_Dict_Slot *slots;
+    size_t capacity; // NOTE(nic): always a power of two
+} Json_Dict_Index;
+
+// NOTE(nic): count and capacity are 32 bits so the index pointer fits without growing Json_Object
 typedef struct {
     Json_Key_Value_Pair *items;
-    size_t count;
-    size_t capacity;
+    uint32_t count;
+    uint32_t capacity;
+    Json_Dict_Index *index;
 } Json_Dict;
 
 typedef struct {
@@ -54,9 +69,17 @@ typedef union {
     String string;
 } Json_Object_As;
 
+typedef enum {
+    JSON_STRING_ESCAPED = 1 << 0, // NOTE(nic): `as.string` still holds the escaped source text
+    JSON_STRING_CHECKED = 1 << 1, // NOTE(nic): `as.string` is decoded and known to be valid UTF-8
+} Json_String_Flags;
+
+// NOTE(nic): parsed strings borrow their bytes from the parsed input. They are only unescaped and
+// checked to be valid UTF-8 once someone asks for them through json_string_decode.
 struct Json_Object {
     Json_Object_As as;
     Json_Object_Kind kind;
+    uint8_t flags;
 };
 
 struct Json_Key_Value_Pair {
@@ -87,9 +110,28 @@ typedef struct {
 } Json_Token;
 
 typedef struct {
-    String_View content;
-    size_t cursor;
-} Json_Lexer;
+    String str;
+    uint32_t hash;
+} Json_Interned;
+
+// NOTE(nic): every distinct key of a parse is stored once, so equal keys share the same pointer.
+// Lookup keys interned in the same table share it too, which lets indexed dicts find them by pointer.
+typedef struct {
+    Json_Interned *items;
+    size_t count;
+    size_t capacity; // NOTE(nic): always a power of two
+} Json_Interner;
+
+// NOTE(nic): inputs smaller than this are lexed byte by byte, building the index is not worth it
+#define JSON_STRUCTURAL_INDEX_MIN_SIZE 1024
+
+// NOTE(nic): offsets of every structural character, both quotes of every string
+// and the first character of every other literal, in input order
+typedef struct {
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} Json_Structural_Index;
 
 typedef struct {
     bool failed;
@@ -97,6 +139,44 @@ typedef struct {
     size_t error_loc;
 } Json_Result;
 
+typedef struct {
+    Json_Key_Value_Pair *items;
+    size_t count;
+    size_t capacity;
+} Json_Pair_Stack;
+
+typedef struct {
+    Json_Object *items;
+    size_t count;
+    size_t capacity;
+} Json_Object_Stack;
+
+// NOTE(nic): items of the dicts and arrays that are still open. Each container is copied into the parse arena
+// once it is closed, sized to its count, so no buffer grown along the way is left behind there.
+typedef struct {
+    Arena arena;
+    Json_Pair_Stack pairs;
+    Json_Object_Stack items;
+} Json_Parse_Stack;
+
+// NOTE(nic): `cursor` is always past the last scanned token, which is the lookahead one if there is any
+typedef struct {
+    String_View content;
+    size_t cursor;
+    Json_Interner *interner;
+    Json_Parse_Stack *stack;
+    Json_Structural_Index *index;
+    size_t index_cursor;
+
+    Json_Token lookahead;
+    Json_Result lookahead_result;
+    bool has_lookahead;
+
+    // NOTE(nic): tokens lexed by json_lexer_next and json_lexer_peek together. A token that is peeked and then
+    // taken is lexed once, so after a parse this matches the tokens in the input unless something re-lexed.
+    size_t tokens_scanned;
+} Json_Lexer;
+
 const char *json_token_kind_to_cstr(Json_Token_Kind kind);
 
 String_View json_lexer_consume_chars(Json_Lexer *lexer, size_t count);
@@ -106,9 +186,37 @@ String_View json_lexer_consume_while(Json_Lexer *lexer, int (*func)(int));
 bool json_lexer_starts_with(Json_Lexer *lexer, String_View text);
 bool json_lexer_starts_with_char(Json_Lexer *lexer, char ch);
 
+bool json_build_structural_index(Arena *arena, String_View content, Json_Structural_Index *index);
+void json_lexer_attach_index(Arena *arena, Json_Lexer *lexer);
+
 Json_Result json_lexer_next(Json_Lexer *lexer, Json_Token *token);
 Json_Result json_lexer_peek(Json_Lexer *lexer, Json_Token *token);
 
+// NOTE(nic): for input that is still arriving. When the token at the cursor could go on past the end of
+// `content`, nothing but whitespace is consumed and `incomplete` is set, unless `final` says there is no more input.
+Json_Result json_lexer_next_partial(Json_Lexer *lexer, Json_Token *token, bool final, bool *incomplete);
+
+typedef enum {
+    JSON_WRITE_COMPACT,
+    JSON_WRITE_PRETTY,
+} Json_Write_Mode;
+
+// NOTE(nic): spaces per nesting level in pretty mode
+#define JSON_WRITE_INDENT 4
+
+// NOTE(nic): the writers append to `out`, growing it in `arena`. Strings that are still escaped
+// source text are copied as they are, everything else is escaped on the way out.
+void json_write_reserve(Arena *arena, String *out, size_t extra);
+void json_write_bytes(Arena *arena, String *out, const char *data, size_t size);
+void json_write_char(Arena *arena, String *out, char ch);
+void json_write_indent(Arena *arena, String *out, Json_Write_Mode mode, size_t depth);
+void json_write_string(Arena *arena, String *out, String_View sv);
+void json_write_int64(Arena *arena, String *out, int64_t n);
+void json_write_decimal(Arena *arena, String *out, double n);
+void json_write_obj(Arena *arena, String *out, Json_Object *obj, Json_Write_Mode mode);
+void json_write_dict(Arena *arena, String *out, Json_Dict *dict, Json_Write_Mode mode);
+void json_write_array(Arena *arena, String *out, Json_Array *array, Json_Write_Mode mode);
+
 void json_print_obj(Json_Object *obj);
 void json_print_dict(Json_Dict *dict);
 void json_print_array(Json_Array *array);
@@ -117,9 +225,46 @@ bool json_obj_eq(Json_Object *a, Json_Object *b);
 Json_Object json_obj_string(Arena *arena, const char *cstr);
 
 Json_Result json_parse_expect(Json_Lexer *lexer, Json_Token_Kind kind);
+Json_Result json_parse_value(Arena *arena, Json_Lexer *lexer, Json_Object *object);
 Json_Result json_parse_object(Arena *arena, Json_Lexer *lexer, Json_Object *object);
 Json_Result json_parse(Arena *arena, Json_Object *object, const char *data, size_t size);
+// NOTE(nic): same, with an interner that outlives the parse so lookup keys can go through it as well
+Json_Result json_parse_interned(Arena *arena, Json_Interner *interner, Json_Object *object, const char *data, size_t size);
+
+typedef enum {
+    JSON_SAX_CONTINUE,
+    JSON_SAX_STOP,
+} Json_Sax_Action;
+
+// NOTE(nic): every callback is optional. Strings handed to `key` and `scalar` point into the parsed
+// input whenever they contain no escapes, so they are only valid as long as the input is.
+// Keys are always decoded, string scalars follow the same lazy rules as parsed objects.
+// Returning JSON_SAX_STOP ends the parse early without it being an error.
+typedef struct {
+    void *user_data;
+    Json_Sax_Action (*start_object)(void *user_data);
+    Json_Sax_Action (*end_object)(void *user_data);
+    Json_Sax_Action (*start_array)(void *user_data);
+    Json_Sax_Action (*end_array)(void *user_data);
+    Json_Sax_Action (*key)(void *user_data, String *key);
+    Json_Sax_Action (*scalar)(void *user_data, Json_Object *value);
+} Json_Sax;
+
+Json_Result json_sax_parse_value(Arena *arena, Json_Lexer *lexer, Json_Sax *sax, bool *stopped);
+Json_Result json_sax_parse(Arena *arena, Json_Sax *sax, const char *data, size_t size, bool *stopped);
+
+uint32_t json_hash(const char *data, size_t size);
+String *json_intern(Arena *arena, Json_Interner *interner, String_View raw, size_t loc, Json_Result *result);
+// NOTE(nic): a lookup key for dicts parsed with `interner`, found in them with a hash probe and a pointer compare.
+// `cstr` is borrowed and has to outlive the interner.
+Json_Object json_intern_key(Arena *arena, Json_Interner *interner, const char *cstr);
+void json_dict_build_index(Arena *arena, Json_Dict *dict);
+
+bool json_utf8_validate(String_View sv, size_t *error_index);
+Json_Result json_string_decode(Arena *arena, Json_Object *string);
+String *json_dict_get_decoded_string(Arena *arena, Json_Dict *dict, Json_Object key);
 
+Json_Key_Value_Pair *json_dict_find_pair(Json_Dict *dict, Json_Object *key);
 Json_Object *json_dict_get(Json_Dict *dict, Json_Object key);
 Json_Object *json_array_get(Json_Array *array, size_t index);
 
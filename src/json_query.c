@@ -0,0 +1,457 @@
+#include "./json_query.h"
+#include "./arena.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <string.h>
+
+Json_Result json_query_error(const char *error, size_t loc) {
+    Json_Result result = {0};
+    result.failed = true;
+    result.error = error;
+    result.error_loc = loc;
+    return result;
+}
+
+bool json_query_is_name_char(char ch) {
+    return isalnum((unsigned char)ch) || ch == '_' || ch == '-';
+}
+
+// NOTE(nic): a quoted run, or a bare one of characters `is_char` accepts. Empty means nothing was there.
+String_View json_query_scan(String_View text, size_t *cursor, bool (*is_char)(char), Json_Result *result) {
+    size_t begin = *cursor;
+    if (begin < text.size && text.data[begin] == '"') {
+        size_t end = begin + 1;
+        while (end < text.size && text.data[end] != '"') {
+            end += 1;
+        }
+        if (end >= text.size) {
+            *result = json_query_error("unclosed quote", begin);
+            return (String_View) {0};
+        }
+        *cursor = end + 1;
+        return (String_View) { &text.data[begin + 1], end - begin - 1 };
+    }
+    size_t end = begin;
+    while (end < text.size && is_char(text.data[end])) {
+        end += 1;
+    }
+    *cursor = end;
+    return (String_View) { &text.data[begin], end - begin };
+}
+
+bool json_query_is_value_char(char ch) {
+    return ch != ',' && ch != ']' && ch != '"';
+}
+
+Json_Result json_query_compile_selector(Arena *arena, Json_Query_Step *step, String_View text, size_t *cursor,
+                                        Json_Tape_Key_Id key_id)
+{
+    Json_Result result = {0};
+    size_t i = *cursor;
+    if (i < text.size && text.data[i] == '*') {
+        step->select = JSON_QUERY_SELECT_ALL;
+        i += 1;
+    } else if (i < text.size && isdigit((unsigned char)text.data[i])) {
+        size_t begin = i;
+        while (i < text.size && isdigit((unsigned char)text.data[i])) {
+            i += 1;
+        }
+        int64_t index = 0;
+        if (!sv_parse_int64((String_View) { &text.data[begin], i - begin }, &index)) {
+            return json_query_error("index out of range", begin);
+        }
+        step->select = JSON_QUERY_SELECT_INDEX;
+        step->index = (size_t)index;
+    } else {
+        step->select = JSON_QUERY_SELECT_WHERE;
+        while (true) {
+            Json_Query_Cond cond = {0};
+            size_t begin = i;
+            cond.key = json_query_scan(text, &i, json_query_is_name_char, &result);
+            if (result.failed) {
+                return result;
+            }
+            if (cond.key.size == 0 && i == begin) {
+                return json_query_error("expected key", i);
+            }
+            if (i >= text.size || text.data[i] != '=') {
+                return json_query_error("expected `=`", i);
+            }
+            i += 1;
+            begin = i;
+            cond.value = json_query_scan(text, &i, json_query_is_value_char, &result);
+            if (result.failed) {
+                return result;
+            }
+            if (cond.value.size == 0 && i == begin) {
+                return json_query_error("expected value", i);
+            }
+            cond.key_id = (key_id != NULL) ? key_id(cond.key) : JSON_TAPE_KEY_UNKNOWN;
+            arena_da_append(arena, &step->conds, cond);
+            if (i >= text.size || text.data[i] != ',') {
+                break;
+            }
+            i += 1;
+        }
+    }
+    if (i >= text.size || text.data[i] != ']') {
+        return json_query_error("expected `]`", i);
+    }
+    *cursor = i + 1;
+    return result;
+}
+
+Json_Result json_query_compile(Arena *arena, Json_Query *query, String_View text, Json_Tape_Key_Id key_id) {
+    *query = (Json_Query) {0};
+    query->depth = 1;
+
+    Json_Result result = {0};
+    size_t i = 0;
+    while (true) {
+        Json_Query_Step step = {0};
+        size_t begin = i;
+        step.key = json_query_scan(text, &i, json_query_is_name_char, &result);
+        if (result.failed) {
+            return result;
+        }
+        if (step.key.size == 0 && i == begin) {
+            return json_query_error("expected key", i);
+        }
+        step.key_id = (key_id != NULL) ? key_id(step.key) : JSON_TAPE_KEY_UNKNOWN;
+        if (i < text.size && text.data[i] == '[') {
+            i += 1;
+            result = json_query_compile_selector(arena, &step, text, &i, key_id);
+            if (result.failed) {
+                return result;
+            }
+        }
+        // NOTE(nic): a selector goes through the array and then one of its items
+        query->depth += (step.select == JSON_QUERY_SELECT_NONE) ? 1 : 2;
+        arena_da_append(arena, query, step);
+
+        if (i >= text.size) {
+            break;
+        }
+        if (text.data[i] != '.') {
+            return json_query_error("expected `.` or `[`", i);
+        }
+        i += 1;
+    }
+    return result;
+}
+
+bool json_query_scalar_eq(Json_Object_Kind kind, Json_Object_As *as, String_View raw, String_View value) {
+    switch (kind) {
+    case JSON_OBJ_NULL:
+        return sv_eq(value, SV("null"));
+    case JSON_OBJ_BOOLEAN:
+        return sv_eq(value, as->boolean ? SV("true") : SV("false"));
+    case JSON_OBJ_INT64: {
+        int64_t n = 0;
+        return sv_parse_int64(value, &n) && n == as->int64;
+    }
+    case JSON_OBJ_DECIMAL: {
+        double n = 0;
+        return sv_parse_decimal(value, &n) && n == as->decimal;
+    }
+    case JSON_OBJ_STRING:
+        return sv_eq(raw, value);
+    default:
+        return false;
+    }
+}
+
+bool json_query_tape_value_eq(Json_Tape *tape, size_t index, String_View value) {
+    Json_Tape_Entry *entry = &tape->items[index];
+    Json_Object_As as = {0};
+    String_View raw = {0};
+    switch (entry->kind) {
+    case JSON_OBJ_BOOLEAN: as.boolean = entry->as.boolean; break;
+    case JSON_OBJ_INT64: as.int64 = entry->as.int64; break;
+    case JSON_OBJ_DECIMAL: as.decimal = entry->as.decimal; break;
+    case JSON_OBJ_STRING: raw = json_tape_raw_string(tape, index); break;
+    default: break;
+    }
+    return json_query_scalar_eq(entry->kind, &as, raw, value);
+}
+
+bool json_query_tape_key_eq(Json_Tape *tape, size_t index, String_View key, uint16_t key_id) {
+    uint16_t tape_key_id = tape->items[index].key_id;
+    if (key_id != JSON_TAPE_KEY_UNKNOWN && tape_key_id != JSON_TAPE_KEY_UNKNOWN) {
+        return key_id == tape_key_id;
+    }
+    return sv_eq(json_tape_raw_string(tape, index), key);
+}
+
+// NOTE(nic): like json_tape_dict_get, but only over the pairs before `limit`, so it works on dicts that are
+// still being parsed as long as every value before `limit` is complete
+size_t json_query_tape_find(Json_Tape *tape, size_t dict, size_t limit, String_View key, uint16_t key_id) {
+    size_t curr = dict + 1;
+    while (curr < limit) {
+        if (json_query_tape_key_eq(tape, curr, key, key_id)) {
+            return curr + 1;
+        }
+        curr = json_tape_skip(tape, curr + 1);
+    }
+    return JSON_TAPE_NONE;
+}
+
+typedef enum {
+    JSON_QUERY_MATCH,
+    JSON_QUERY_MISMATCH,
+    JSON_QUERY_UNKNOWN, // NOTE(nic): nothing disagrees so far, but some of the keys are not there (yet)
+} Json_Query_Check;
+
+Json_Query_Check json_query_tape_check(Json_Query_Step *step, Json_Tape *tape, size_t item, size_t limit) {
+    if (step->select != JSON_QUERY_SELECT_WHERE) {
+        return JSON_QUERY_MATCH;
+    }
+    if (tape->items[item].kind != JSON_OBJ_DICT) {
+        return JSON_QUERY_MISMATCH;
+    }
+    Json_Query_Check check = JSON_QUERY_MATCH;
+    for (size_t i = 0; i < step->conds.count; ++i) {
+        Json_Query_Cond *cond = &step->conds.items[i];
+        size_t value = json_query_tape_find(tape, item, limit, cond->key, cond->key_id);
+        if (value == JSON_TAPE_NONE) {
+            check = JSON_QUERY_UNKNOWN;
+        } else if (!json_query_tape_value_eq(tape, value, cond->value)) {
+            return JSON_QUERY_MISMATCH;
+        }
+    }
+    return check;
+}
+
+void json_query_tape_collect(Arena *arena, Json_Query *query, Json_Tape *tape, size_t index, size_t step_index,
+                             Json_Query_Indices *matches)
+{
+    if (step_index == query->count) {
+        arena_da_append(arena, matches, index);
+        return;
+    }
+    if (tape->items[index].kind != JSON_OBJ_DICT) {
+        return;
+    }
+    Json_Query_Step *step = &query->items[step_index];
+    size_t value = json_query_tape_find(tape, index, tape->items[index].as.end, step->key, step->key_id);
+    if (value == JSON_TAPE_NONE) {
+        return;
+    }
+    if (step->select == JSON_QUERY_SELECT_NONE) {
+        json_query_tape_collect(arena, query, tape, value, step_index + 1, matches);
+        return;
+    }
+    if (tape->items[value].kind != JSON_OBJ_ARRAY) {
+        return;
+    }
+
+    size_t end = tape->items[value].as.end;
+    size_t position = 0;
+    for (size_t item = value + 1; item < end; item = json_tape_skip(tape, item), ++position) {
+        if (step->select == JSON_QUERY_SELECT_INDEX && position != step->index) {
+            continue;
+        }
+        size_t item_end = json_tape_skip(tape, item);
+        if (json_query_tape_check(step, tape, item, item_end) == JSON_QUERY_MATCH) {
+            json_query_tape_collect(arena, query, tape, item, step_index + 1, matches);
+        }
+    }
+}
+
+void json_query_tape(Arena *arena, Json_Query *query, Json_Tape *tape, size_t root, Json_Query_Indices *matches) {
+    json_query_tape_collect(arena, query, tape, root, 0, matches);
+}
+
+size_t json_query_tape_first(Json_Query *query, Json_Tape *tape, size_t root) {
+    Arena scratch = {0};
+    Json_Query_Indices matches = {0};
+    json_query_tape(&scratch, query, tape, root, &matches);
+    size_t first = (matches.count > 0) ? matches.items[0] : JSON_TAPE_NONE;
+    arena_free(&scratch);
+    return first;
+}
+
+bool json_query_obj_eq(Json_Object *obj, String_View value) {
+    String_View raw = {0};
+    if (obj->kind == JSON_OBJ_STRING) {
+        raw = (String_View) { obj->as.string.items, obj->as.string.count };
+    }
+    return json_query_scalar_eq(obj->kind, &obj->as, raw, value);
+}
+
+Json_Object *json_query_obj_find(Json_Dict *dict, String_View key) {
+    Json_Object key_obj = {0};
+    key_obj.kind = JSON_OBJ_STRING;
+    key_obj.as.string = (String) { (char *)key.data, key.size, key.size };
+    return json_dict_get(dict, key_obj);
+}
+
+void json_query_obj_collect(Arena *arena, Json_Query *query, Json_Object *obj, size_t step_index,
+                            Json_Query_Objects *matches)
+{
+    if (step_index == query->count) {
+        arena_da_append(arena, matches, obj);
+        return;
+    }
+    if (obj->kind != JSON_OBJ_DICT) {
+        return;
+    }
+    Json_Query_Step *step = &query->items[step_index];
+    Json_Object *value = json_query_obj_find(&obj->as.dict, step->key);
+    if (value == NULL) {
+        return;
+    }
+    if (step->select == JSON_QUERY_SELECT_NONE) {
+        json_query_obj_collect(arena, query, value, step_index + 1, matches);
+        return;
+    }
+    if (value->kind != JSON_OBJ_ARRAY) {
+        return;
+    }
+
+    Json_Array *array = &value->as.array;
+    for (size_t i = 0; i < array->count; ++i) {
+        if (step->select == JSON_QUERY_SELECT_INDEX && i != step->index) {
+            continue;
+        }
+        Json_Object *item = &array->items[i];
+        if (step->select == JSON_QUERY_SELECT_WHERE) {
+            if (item->kind != JSON_OBJ_DICT) {
+                continue;
+            }
+            bool matched = true;
+            for (size_t j = 0; j < step->conds.count && matched; ++j) {
+                Json_Object *cond_value = json_query_obj_find(&item->as.dict, step->conds.items[j].key);
+                matched = cond_value != NULL && json_query_obj_eq(cond_value, step->conds.items[j].value);
+            }
+            if (!matched) {
+                continue;
+            }
+        }
+        json_query_obj_collect(arena, query, item, step_index + 1, matches);
+    }
+}
+
+void json_query_obj(Arena *arena, Json_Query *query, Json_Object *root, Json_Query_Objects *matches) {
+    json_query_obj_collect(arena, query, root, 0, matches);
+}
+
+typedef enum {
+    JSON_QUERY_ON_PATH,  // NOTE(nic): the innermost open container is where the first `steps` steps lead
+    JSON_QUERY_INSIDE,   // NOTE(nic): it is somewhere inside a match
+    JSON_QUERY_OFF_PATH, // NOTE(nic): there can be no match at or below it
+} Json_Query_Walk;
+
+// NOTE(nic): follows the query down the containers the parser has open. Every open container is the value
+// of the last pair or item of the one before it, and the pairs before that are complete.
+Json_Query_Walk json_query_walk(Json_Query *query, Json_Tape_Parser *parser, size_t *steps) {
+    Json_Tape *tape = &parser->tape;
+    size_t *open = parser->open.items;
+    size_t step_index = 0;
+    bool selecting = false;
+    for (size_t i = 1; i < parser->open.count; ++i) {
+        size_t parent = open[i - 1];
+        size_t child = open[i];
+        if (selecting) {
+            Json_Query_Step *step = &query->items[step_index - 1];
+            // NOTE(nic): the size only counts finished items, so it is also the index of the open one
+            if (step->select == JSON_QUERY_SELECT_INDEX && tape->items[parent].size != step->index) {
+                return JSON_QUERY_OFF_PATH;
+            }
+            size_t limit = (i + 1 < parser->open.count) ? open[i + 1] - 1 : tape->count;
+            if (json_query_tape_check(step, tape, child, limit) == JSON_QUERY_MISMATCH) {
+                return JSON_QUERY_OFF_PATH;
+            }
+            selecting = false;
+            continue;
+        }
+        if (step_index == query->count) {
+            return JSON_QUERY_INSIDE;
+        }
+        Json_Query_Step *step = &query->items[step_index];
+        if (tape->items[parent].kind != JSON_OBJ_DICT
+            || !json_query_tape_key_eq(tape, child - 1, step->key, step->key_id))
+        {
+            return JSON_QUERY_OFF_PATH;
+        }
+        step_index += 1;
+        if (step->select != JSON_QUERY_SELECT_NONE) {
+            if (tape->items[child].kind != JSON_OBJ_ARRAY) {
+                return JSON_QUERY_OFF_PATH;
+            }
+            selecting = true;
+        }
+    }
+    if (selecting) {
+        // NOTE(nic): an array that still has to have its items selected, nothing inside it is a match yet
+        *steps = step_index - 1;
+        return JSON_QUERY_ON_PATH;
+    }
+    *steps = step_index;
+    return JSON_QUERY_ON_PATH;
+}
+
+bool json_query_sv_key_eq(String_View key, uint16_t key_id, String_View query_key, uint16_t query_key_id) {
+    if (key_id != JSON_TAPE_KEY_UNKNOWN && query_key_id != JSON_TAPE_KEY_UNKNOWN) {
+        return key_id == query_key_id;
+    }
+    return sv_eq(key, query_key);
+}
+
+bool json_query_on_key(void *user_data, Json_Tape_Parser *parser, String_View key, uint16_t key_id) {
+    Json_Query *query = ((Json_Query_Stream *)user_data)->query;
+    size_t steps = 0;
+    switch (json_query_walk(query, parser, &steps)) {
+    case JSON_QUERY_OFF_PATH:
+        return false;
+    case JSON_QUERY_INSIDE:
+        return true;
+    case JSON_QUERY_ON_PATH:
+        break;
+    }
+    if (steps == query->count) {
+        return true;
+    }
+
+    // NOTE(nic): on the way to a match only the next key and whatever the conditions on this dict look at are kept
+    Json_Query_Step *next = &query->items[steps];
+    if (json_query_sv_key_eq(key, key_id, next->key, next->key_id)) {
+        return true;
+    }
+    if (steps > 0) {
+        Json_Query_Conds *conds = &query->items[steps - 1].conds;
+        for (size_t i = 0; i < conds->count; ++i) {
+            if (json_query_sv_key_eq(key, key_id, conds->items[i].key, conds->items[i].key_id)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool json_query_on_close(void *user_data, Json_Tape_Parser *parser, size_t container) {
+    Json_Query_Stream *stream = user_data;
+    Json_Query *query = stream->query;
+    if (parser->open.count != query->depth) {
+        return false;
+    }
+    size_t steps = 0;
+    if (json_query_walk(query, parser, &steps) != JSON_QUERY_ON_PATH || steps != query->count) {
+        return false;
+    }
+    Json_Query_Step *last = &query->items[query->count - 1];
+    if (json_query_tape_check(last, &parser->tape, container, parser->tape.count) != JSON_QUERY_MATCH) {
+        return false;
+    }
+    stream->match = container;
+    return true;
+}
+
+void json_query_stream_attach(Json_Query_Stream *stream, Json_Query *query, Json_Tape_Parser *parser) {
+    stream->query = query;
+    stream->match = JSON_TAPE_NONE;
+    parser->on_key = json_query_on_key;
+    parser->on_close = json_query_on_close;
+    parser->user_data = stream;
+}
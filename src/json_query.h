@@ -0,0 +1,95 @@
+#ifndef JSON_QUERY_H_
+#define JSON_QUERY_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "./arena.h"
+#include "./utils.h"
+#include "./json.h"
+#include "./json_tape.h"
+
+// NOTE(nic): a query is a chain of steps separated by dots, each one naming a key of the current dict,
+// optionally followed by a selector on the array under that key:
+//
+//     nodes[*]                 every item
+//     nodes[2]                 the item at that index
+//     nodes[type=workspace]    every dict item whose values are all equal to the given ones,
+//                              as many `key=value` as needed separated by commas
+//
+// e.g. `nodes[*].nodes[*].nodes[type=workspace,name=__i3_scratch]`. Keys and values can be quoted
+// when they have to contain any of `.[],=`, there are no escapes. Values are compared against the raw text
+// of strings and against the value of numbers, booleans and null.
+
+typedef enum {
+    JSON_QUERY_SELECT_NONE, // NOTE(nic): the value under the key itself
+    JSON_QUERY_SELECT_ALL,
+    JSON_QUERY_SELECT_INDEX,
+    JSON_QUERY_SELECT_WHERE,
+} Json_Query_Select;
+
+typedef struct {
+    String_View key;
+    uint16_t key_id;
+    String_View value;
+} Json_Query_Cond;
+
+typedef struct {
+    Json_Query_Cond *items;
+    size_t count;
+    size_t capacity;
+} Json_Query_Conds;
+
+typedef struct {
+    String_View key;
+    uint16_t key_id;
+    Json_Query_Select select;
+    size_t index;
+    Json_Query_Conds conds;
+} Json_Query_Step;
+
+// NOTE(nic): keys and values point into the compiled text, which has to outlive the query
+typedef struct {
+    Json_Query_Step *items;
+    size_t count;
+    size_t capacity;
+    size_t depth; // NOTE(nic): containers from the root to a match, both included
+} Json_Query;
+
+// NOTE(nic): with `key_id` set, the keys are also resolved to ids once here, and compared by id against
+// tapes whose keys were tagged by the same function
+Json_Result json_query_compile(Arena *arena, Json_Query *query, String_View text, Json_Tape_Key_Id key_id);
+
+typedef struct {
+    Json_Object **items;
+    size_t count;
+    size_t capacity;
+} Json_Query_Objects;
+
+typedef struct {
+    size_t *items;
+    size_t count;
+    size_t capacity;
+} Json_Query_Indices;
+
+// NOTE(nic): append every match in document order
+void json_query_obj(Arena *arena, Json_Query *query, Json_Object *root, Json_Query_Objects *matches);
+void json_query_tape(Arena *arena, Json_Query *query, Json_Tape *tape, size_t root, Json_Query_Indices *matches);
+size_t json_query_tape_first(Json_Query *query, Json_Tape *tape, size_t root);
+
+// NOTE(nic): runs a query while a tape parser builds its tape. Pairs that can not lead to a match are skipped
+// without being built, and the parse stops as soon as the first dict or array that matches is complete.
+// The whole subtree of a match is kept, subject to the parser's own `known_keys_only`, so every query key
+// has to be known to its `key_id` when projecting.
+//
+// Conditions on the dicts around a match can only be checked against the pairs that came before it,
+// a match that depends on later ones is missed here but still found by json_query_tape on the finished tape.
+typedef struct {
+    Json_Query *query;
+    size_t match; // NOTE(nic): tape index of the match, JSON_TAPE_NONE until there is one
+} Json_Query_Stream;
+
+void json_query_stream_attach(Json_Query_Stream *stream, Json_Query *query, Json_Tape_Parser *parser);
+
+#endif // JSON_QUERY_H_
@@ -0,0 +1,830 @@
+#define _POSIX_C_SOURCE 200809L
+#include "./json_tape.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <string.h>
+#include <pthread.h>
+
+Json_Tape_Entry *json_tape_push(Arena *arena, Json_Tape *tape, Json_Object_Kind kind) {
+    Json_Tape_Entry entry = {0};
+    entry.kind = (uint8_t)kind;
+    arena_da_append(arena, tape, entry);
+    return &tape->items[tape->count - 1];
+}
+
+void json_tape_push_string(Arena *arena, Json_Tape *tape, Json_Token *token) {
+    Json_Tape_Entry *entry = json_tape_push(arena, tape, JSON_OBJ_STRING);
+    entry->flags = sv_find(token->text, '\\', NULL) ? JSON_STRING_ESCAPED : 0;
+    entry->size = (uint32_t)token->text.size;
+    entry->as.offset = (uint32_t)(token->text.data - tape->source.data);
+}
+
+// NOTE(nic): returns false if the token is not a scalar, nothing is pushed then
+bool json_tape_push_scalar(Arena *arena, Json_Tape *tape, Json_Token *token) {
+    switch (token->kind) {
+    case JSON_TOKEN_TRUE:
+    case JSON_TOKEN_FALSE: {
+        Json_Tape_Entry *entry = json_tape_push(arena, tape, JSON_OBJ_BOOLEAN);
+        entry->as.boolean = token->kind == JSON_TOKEN_TRUE;
+    } break;
+    case JSON_TOKEN_NULL: {
+        json_tape_push(arena, tape, JSON_OBJ_NULL);
+    } break;
+    case JSON_TOKEN_INT64: {
+        Json_Tape_Entry *entry = json_tape_push(arena, tape, JSON_OBJ_INT64);
+        entry->as.int64 = sv_to_int64(token->text);
+    } break;
+    case JSON_TOKEN_DECIMAL: {
+        Json_Tape_Entry *entry = json_tape_push(arena, tape, JSON_OBJ_DECIMAL);
+        entry->as.decimal = sv_to_decimal(token->text);
+    } break;
+    case JSON_TOKEN_STRING: {
+        json_tape_push_string(arena, tape, token);
+    } break;
+    default: {
+        return false;
+    }
+    }
+    return true;
+}
+
+Json_Result json_tape_parse_value(Arena *arena, Json_Lexer *lexer, Json_Tape *tape) {
+    Json_Token token = {0};
+    Json_Result result = json_lexer_next(lexer, &token);
+    if (result.failed) {
+        return result;
+    }
+    switch (token.kind) {
+    case JSON_TOKEN_OPEN_CURLY:
+    case JSON_TOKEN_OPEN_BRACKET: {
+        bool is_dict = token.kind == JSON_TOKEN_OPEN_CURLY;
+        Json_Token_Kind close = is_dict ? JSON_TOKEN_CLOSE_CURLY : JSON_TOKEN_CLOSE_BRACKET;
+        // NOTE(nic): entries may move while the children are appended, so keep the index only
+        size_t container = tape->count;
+        json_tape_push(arena, tape, is_dict ? JSON_OBJ_DICT : JSON_OBJ_ARRAY);
+        uint32_t size = 0;
+        while (true) {
+            Json_Token peek = {0};
+            result = json_lexer_peek(lexer, &peek);
+            if (result.failed) {
+                return result;
+            }
+            if (peek.kind == close) {
+                json_lexer_next(lexer, &peek);
+                break;
+            }
+            if (is_dict) {
+                json_lexer_next(lexer, &peek);
+                if (peek.kind != JSON_TOKEN_STRING) {
+                    result.failed = true;
+                    result.error = "expected string key";
+                    result.error_loc = peek.loc;
+                    return result;
+                }
+                json_tape_push_string(arena, tape, &peek);
+                result = json_parse_expect(lexer, JSON_TOKEN_COLON);
+                if (result.failed) {
+                    return result;
+                }
+            }
+            result = json_tape_parse_value(arena, lexer, tape);
+            if (result.failed) {
+                return result;
+            }
+            size += 1;
+            result = json_lexer_peek(lexer, &peek);
+            if (result.failed) {
+                return result;
+            }
+            if (peek.kind == JSON_TOKEN_COMMA) {
+                json_lexer_next(lexer, &peek);
+            } else if (peek.kind != close) {
+                result.failed = true;
+                result.error = "unexpected token";
+                result.error_loc = peek.loc;
+                return result;
+            }
+        }
+        tape->items[container].size = size;
+        tape->items[container].as.end = (uint32_t)tape->count;
+    } break;
+    case JSON_TOKEN_END: {
+        result.failed = true;
+        result.error = "unexpected end of json";
+        result.error_loc = token.loc;
+    } break;
+    default: {
+        if (!json_tape_push_scalar(arena, tape, &token)) {
+            result.failed = true;
+            result.error = "unexpected token";
+            result.error_loc = token.loc;
+        }
+    }
+    }
+    return result;
+}
+
+Json_Result json_tape_parse(Arena *arena, Json_Tape *tape, const char *data, size_t size) {
+    Json_Result result = {0};
+    if (size > UINT32_MAX) {
+        result.failed = true;
+        result.error = "input too big for a tape";
+        return result;
+    }
+
+    *tape = (Json_Tape) {0};
+    tape->source = (String_View) { data, size };
+
+    Json_Lexer lexer = { .content = tape->source };
+    json_lexer_attach_index(arena, &lexer);
+    if (lexer.index != NULL) {
+        // NOTE(nic): there are never more entries than index entries, so the tape is allocated exactly once
+        tape->capacity = lexer.index->count;
+        tape->items = arena_alloc(arena, tape->capacity * sizeof(*tape->items));
+    }
+    return json_tape_parse_value(arena, &lexer, tape);
+}
+
+void json_tape_parser_reserve(Arena *arena, Json_Tape_Parser *parser, size_t size_hint) {
+    assert(parser->buffer.count == 0 && parser->tape.count == 0);
+    if (size_hint > 0) {
+        parser->buffer = str_with_cap(arena, size_hint);
+    }
+    // NOTE(nic): with a projection there is no telling how much of the input survives, so the tape just grows
+    if (size_hint > 0 && !parser->known_keys_only) {
+        parser->tape.capacity = size_hint/JSON_TAPE_BYTES_PER_ENTRY_HINT + 1;
+        parser->tape.items = arena_alloc(arena, parser->tape.capacity * sizeof(*parser->tape.items));
+    }
+}
+
+Json_Result json_tape_parser_error(Json_Tape_Parser *parser, const char *error, size_t loc) {
+    parser->result.failed = true;
+    parser->result.error = error;
+    parser->result.error_loc = loc;
+    return parser->result;
+}
+
+// NOTE(nic): a value just ended, either the document is done or its container gets one more item
+void json_tape_parser_value_done(Json_Tape_Parser *parser) {
+    if (parser->open.count == 0) {
+        parser->state = JSON_TAPE_EXPECT_END;
+        return;
+    }
+    parser->tape.items[parser->open.items[parser->open.count - 1]].size += 1;
+    parser->state = JSON_TAPE_EXPECT_COMMA_OR_CLOSE;
+}
+
+Json_Result json_tape_parser_close(Json_Tape_Parser *parser, Json_Token *token) {
+    if (parser->open.count == 0) {
+        return json_tape_parser_error(parser, "unexpected token", token->loc);
+    }
+    size_t container = parser->open.items[parser->open.count - 1];
+    Json_Object_Kind kind = parser->tape.items[container].kind;
+    if ((kind == JSON_OBJ_DICT) != (token->kind == JSON_TOKEN_CLOSE_CURLY)) {
+        return json_tape_parser_error(parser, "unexpected token", token->loc);
+    }
+    parser->tape.items[container].as.end = (uint32_t)parser->tape.count;
+    if (parser->on_close != NULL && parser->on_close(parser->user_data, parser, container)) {
+        parser->stopped = true;
+        // NOTE(nic): every container around this one is cut short right after it, and counts the item
+        // it was in the middle of, which is where the path to this one goes through
+        for (size_t i = 0; i < parser->open.count; ++i) {
+            Json_Tape_Entry *open = &parser->tape.items[parser->open.items[i]];
+            open->as.end = (uint32_t)parser->tape.count;
+            if (i + 1 < parser->open.count) {
+                open->size += 1;
+            }
+        }
+        return parser->result;
+    }
+    parser->open.count -= 1;
+    json_tape_parser_value_done(parser);
+    return parser->result;
+}
+
+Json_Result json_tape_parser_value(Arena *arena, Json_Tape_Parser *parser, Json_Token *token) {
+    Json_Tape *tape = &parser->tape;
+    switch (token->kind) {
+    case JSON_TOKEN_OPEN_CURLY:
+    case JSON_TOKEN_OPEN_BRACKET: {
+        bool is_dict = token->kind == JSON_TOKEN_OPEN_CURLY;
+        arena_da_append(arena, &parser->open, tape->count);
+        json_tape_push(arena, tape, is_dict ? JSON_OBJ_DICT : JSON_OBJ_ARRAY);
+        parser->state = is_dict ? JSON_TAPE_EXPECT_KEY_OR_CLOSE : JSON_TAPE_EXPECT_VALUE_OR_CLOSE;
+    } break;
+    case JSON_TOKEN_END: {
+        return json_tape_parser_error(parser, "unexpected end of json", token->loc);
+    }
+    default: {
+        if (!json_tape_push_scalar(arena, tape, token)) {
+            return json_tape_parser_error(parser, "unexpected token", token->loc);
+        }
+        json_tape_parser_value_done(parser);
+    }
+    }
+    return parser->result;
+}
+
+// NOTE(nic): moves the cursor over the value of a pair that is not kept, up to the `,` or `}` that ends it.
+// The value goes through the same lexer and grammar as a kept one, it just never makes it onto the tape.
+// Returns false if the buffer runs out first or the value is invalid, `parser->result` tells which.
+bool json_tape_parser_skip(Arena *arena, Json_Tape_Parser *parser, Json_Lexer *lexer, bool final) {
+    Json_Tape_Skip_Open *open = &parser->skip_open;
+    while (true) {
+        lexer->cursor = parser->cursor;
+        Json_Token token = {0};
+        bool incomplete = false;
+        Json_Result result = json_lexer_next_partial(lexer, &token, final, &incomplete);
+        if (result.failed) {
+            parser->result = result;
+            return false;
+        }
+        if (incomplete) {
+            return false;
+        }
+        if (token.kind == JSON_TOKEN_END) {
+            json_tape_parser_error(parser, "unexpected end of json", token.loc);
+            return false;
+        }
+
+        bool value_done = false;
+        switch (parser->skip_state) {
+        case JSON_TAPE_EXPECT_VALUE_OR_CLOSE:
+        case JSON_TAPE_EXPECT_VALUE:
+            if (token.kind == JSON_TOKEN_CLOSE_BRACKET && parser->skip_state == JSON_TAPE_EXPECT_VALUE_OR_CLOSE) {
+                open->count -= 1;
+                value_done = true;
+            } else if (token.kind == JSON_TOKEN_OPEN_CURLY || token.kind == JSON_TOKEN_OPEN_BRACKET) {
+                bool is_dict = token.kind == JSON_TOKEN_OPEN_CURLY;
+                arena_da_append(arena, open, is_dict);
+                parser->skip_state = is_dict ? JSON_TAPE_EXPECT_KEY_OR_CLOSE : JSON_TAPE_EXPECT_VALUE_OR_CLOSE;
+            } else if (token.kind == JSON_TOKEN_STRING || token.kind == JSON_TOKEN_INT64 ||
+                       token.kind == JSON_TOKEN_DECIMAL || token.kind == JSON_TOKEN_TRUE ||
+                       token.kind == JSON_TOKEN_FALSE || token.kind == JSON_TOKEN_NULL) {
+                value_done = true;
+            } else {
+                json_tape_parser_error(parser, "unexpected token", token.loc);
+                return false;
+            }
+            break;
+        case JSON_TAPE_EXPECT_KEY_OR_CLOSE:
+            if (token.kind == JSON_TOKEN_CLOSE_CURLY) {
+                open->count -= 1;
+                value_done = true;
+                break;
+            }
+            /* fallthrough */
+        case JSON_TAPE_EXPECT_KEY:
+            if (token.kind != JSON_TOKEN_STRING) {
+                json_tape_parser_error(parser, "expected string key", token.loc);
+                return false;
+            }
+            parser->skip_state = JSON_TAPE_EXPECT_COLON;
+            break;
+        case JSON_TAPE_EXPECT_COLON:
+            if (token.kind != JSON_TOKEN_COLON) {
+                json_tape_parser_error(parser, "unexpected token", token.loc);
+                return false;
+            }
+            parser->skip_state = JSON_TAPE_EXPECT_VALUE;
+            break;
+        case JSON_TAPE_EXPECT_COMMA_OR_CLOSE: {
+            bool is_dict = open->items[open->count - 1];
+            if (token.kind == JSON_TOKEN_COMMA) {
+                parser->skip_state = is_dict ? JSON_TAPE_EXPECT_KEY : JSON_TAPE_EXPECT_VALUE;
+            } else if (token.kind == (is_dict ? JSON_TOKEN_CLOSE_CURLY : JSON_TOKEN_CLOSE_BRACKET)) {
+                open->count -= 1;
+                value_done = true;
+            } else {
+                json_tape_parser_error(parser, "unexpected token", token.loc);
+                return false;
+            }
+        } break;
+        default:
+            assert(0 && "unreachable");
+        }
+        parser->cursor = lexer->cursor;
+
+        if (value_done) {
+            if (open->count == 0) {
+                return true;
+            }
+            parser->skip_state = JSON_TAPE_EXPECT_COMMA_OR_CLOSE;
+        }
+    }
+}
+
+Json_Result json_tape_parser_step(Arena *arena, Json_Tape_Parser *parser, Json_Token *token) {
+    if (token->kind == JSON_TOKEN_END && parser->state != JSON_TAPE_EXPECT_END) {
+        return json_tape_parser_error(parser, "unexpected end of json", token->loc);
+    }
+    switch (parser->state) {
+    case JSON_TAPE_EXPECT_VALUE_OR_CLOSE:
+        if (token->kind == JSON_TOKEN_CLOSE_BRACKET) {
+            return json_tape_parser_close(parser, token);
+        }
+        return json_tape_parser_value(arena, parser, token);
+    case JSON_TAPE_EXPECT_VALUE:
+        return json_tape_parser_value(arena, parser, token);
+    case JSON_TAPE_EXPECT_KEY_OR_CLOSE:
+        if (token->kind == JSON_TOKEN_CLOSE_CURLY) {
+            return json_tape_parser_close(parser, token);
+        }
+        /* fallthrough */
+    case JSON_TAPE_EXPECT_KEY:
+        if (token->kind != JSON_TOKEN_STRING) {
+            return json_tape_parser_error(parser, "expected string key", token->loc);
+        }
+        uint16_t key_id = (parser->key_id != NULL) ? parser->key_id(token->text) : JSON_TAPE_KEY_UNKNOWN;
+        parser->skip_pair = parser->known_keys_only && key_id == JSON_TAPE_KEY_UNKNOWN;
+        if (!parser->skip_pair && parser->on_key != NULL) {
+            parser->skip_pair = !parser->on_key(parser->user_data, parser, token->text, key_id);
+        }
+        if (!parser->skip_pair) {
+            json_tape_push_string(arena, &parser->tape, token);
+            parser->tape.items[parser->tape.count - 1].key_id = key_id;
+        }
+        parser->state = JSON_TAPE_EXPECT_COLON;
+        return parser->result;
+    case JSON_TAPE_EXPECT_COLON:
+        if (token->kind != JSON_TOKEN_COLON) {
+            return json_tape_parser_error(parser, "unexpected token", token->loc);
+        }
+        if (parser->skip_pair) {
+            parser->state = JSON_TAPE_SKIP_VALUE;
+            parser->skip_state = JSON_TAPE_EXPECT_VALUE;
+            parser->skip_open.count = 0;
+        } else {
+            parser->state = JSON_TAPE_EXPECT_VALUE;
+        }
+        return parser->result;
+    case JSON_TAPE_EXPECT_COMMA_OR_CLOSE:
+        if (token->kind == JSON_TOKEN_COMMA) {
+            size_t container = parser->open.items[parser->open.count - 1];
+            bool is_dict = parser->tape.items[container].kind == JSON_OBJ_DICT;
+            parser->state = is_dict ? JSON_TAPE_EXPECT_KEY : JSON_TAPE_EXPECT_VALUE;
+            return parser->result;
+        }
+        if (token->kind == JSON_TOKEN_CLOSE_CURLY || token->kind == JSON_TOKEN_CLOSE_BRACKET) {
+            return json_tape_parser_close(parser, token);
+        }
+        return json_tape_parser_error(parser, "unexpected token", token->loc);
+    case JSON_TAPE_EXPECT_END:
+        if (token->kind != JSON_TOKEN_END) {
+            return json_tape_parser_error(parser, "unexpected token", token->loc);
+        }
+        return parser->result;
+    default:
+        assert(0 && "unreachable");
+        return parser->result;
+    }
+}
+
+// NOTE(nic): runs over every complete token fed so far, a token cut by the end of the buffer is
+// picked up again from its first byte on the next call
+Json_Result json_tape_parser_advance(Arena *arena, Json_Tape_Parser *parser, bool final) {
+    Json_Tape *tape = &parser->tape;
+    // NOTE(nic): the buffer may have moved, tape strings are offsets so they do not care
+    tape->source = (String_View) { parser->buffer.items, parser->buffer.count };
+    Json_Lexer lexer = { .content = tape->source };
+    while (!parser->result.failed && !parser->stopped) {
+        if (parser->state == JSON_TAPE_SKIP_VALUE) {
+            if (!json_tape_parser_skip(arena, parser, &lexer, final)) {
+                break;
+            }
+            // NOTE(nic): the pair is gone entirely, so the dict size stays as it was
+            parser->state = JSON_TAPE_EXPECT_COMMA_OR_CLOSE;
+        }
+
+        lexer.cursor = parser->cursor;
+        Json_Token token = {0};
+        bool incomplete = false;
+        Json_Result result = json_lexer_next_partial(&lexer, &token, final, &incomplete);
+        if (result.failed) {
+            parser->result = result;
+            break;
+        }
+        parser->cursor = lexer.cursor;
+        if (incomplete) {
+            break;
+        }
+        json_tape_parser_step(arena, parser, &token);
+        if (token.kind == JSON_TOKEN_END) {
+            break;
+        }
+    }
+    return parser->result;
+}
+
+Json_Result json_tape_parser_feed(Arena *arena, Json_Tape_Parser *parser, const char *data, size_t size) {
+    if (parser->result.failed || parser->stopped) {
+        return parser->result;
+    }
+    if (parser->buffer.count + size > UINT32_MAX) {
+        return json_tape_parser_error(parser, "input too big for a tape", parser->buffer.count);
+    }
+    arena_da_append_many(arena, &parser->buffer, data, size);
+    return json_tape_parser_advance(arena, parser, false);
+}
+
+Json_Result json_tape_parser_commit(Arena *arena, Json_Tape_Parser *parser, size_t size) {
+    assert(parser->buffer.count + size <= parser->buffer.capacity);
+    parser->buffer.count += size;
+    if (parser->result.failed || parser->stopped) {
+        return parser->result;
+    }
+    return json_tape_parser_advance(arena, parser, false);
+}
+
+Json_Result json_tape_parser_finish(Arena *arena, Json_Tape_Parser *parser) {
+    if (parser->result.failed || parser->stopped) {
+        return parser->result;
+    }
+    json_tape_parser_advance(arena, parser, true);
+    if (!parser->result.failed && !parser->stopped && parser->state != JSON_TAPE_EXPECT_END) {
+        return json_tape_parser_error(parser, "unexpected end of json", parser->buffer.count);
+    }
+    return parser->result;
+}
+
+void json_tape_reserve(Arena *arena, Json_Tape *tape, size_t capacity) {
+    if (capacity <= tape->capacity) {
+        return;
+    }
+    Json_Tape_Entry *items = arena_alloc(arena, capacity * sizeof(*items));
+    if (tape->count > 0) {
+        memcpy(items, tape->items, tape->count * sizeof(*items));
+    }
+    tape->items = items;
+    tape->capacity = capacity;
+}
+
+// NOTE(nic): parses `size` bytes at `data` where they are, as if they had been fed in one go and finished
+Json_Result json_tape_parser_run(Arena *arena, Json_Tape_Parser *parser, const char *data, size_t size) {
+    assert(parser->buffer.count == 0);
+    if (size > UINT32_MAX) {
+        return json_tape_parser_error(parser, "input too big for a tape", 0);
+    }
+    if (!parser->known_keys_only) {
+        json_tape_reserve(arena, &parser->tape, size/JSON_TAPE_BYTES_PER_ENTRY_HINT + 1);
+    }
+    parser->buffer = (String) { (char *)data, size, size };
+    return json_tape_parser_finish(arena, parser);
+}
+
+typedef struct {
+    size_t begin;
+    size_t end;
+} Json_Tape_Range;
+
+typedef struct {
+    Json_Tape_Range *items;
+    size_t count;
+    size_t capacity;
+} Json_Tape_Ranges;
+
+// NOTE(nic): finds where the items of the array under `key` in the root dict start and end, using nothing
+// but the structural index. `open` and `close` are the offsets of its brackets.
+bool json_tape_find_split(Arena *arena, Json_Structural_Index *index, String_View content, String_View key,
+                          size_t *open, size_t *close, Json_Tape_Ranges *items)
+{
+    const char *data = content.data;
+    if (index->count == 0 || data[index->items[0]] != '{') {
+        return false;
+    }
+
+    size_t depth = 0;
+    char prev = 0;
+    size_t i = 0;
+    for (; i < index->count; ++i) {
+        char ch = data[index->items[i]];
+        if (ch == '"') {
+            bool is_key = depth == 1 && (prev == '{' || prev == ',');
+            size_t begin = index->items[i] + 1;
+            size_t end = index->items[i + 1];
+            i += 1;
+            if (is_key && i + 2 < index->count
+                && sv_eq((String_View) { &data[begin], end - begin }, key)
+                && data[index->items[i + 1]] == ':'
+                && data[index->items[i + 2]] == '[')
+            {
+                i += 2;
+                break;
+            }
+            prev = '"';
+            continue;
+        }
+        if (ch == '{' || ch == '[') {
+            depth += 1;
+        } else if (ch == '}' || ch == ']') {
+            if (depth == 0) {
+                return false;
+            }
+            depth -= 1;
+        }
+        prev = ch;
+    }
+    if (i >= index->count) {
+        return false;
+    }
+
+    *open = index->items[i];
+    depth = 0;
+    size_t item_begin = *open + 1;
+    for (i += 1; i < index->count; ++i) {
+        size_t loc = index->items[i];
+        char ch = data[loc];
+        if (ch == '"') {
+            i += 1;
+            continue;
+        }
+        if (ch == '{' || ch == '[') {
+            depth += 1;
+        } else if ((ch == '}' || ch == ']') && depth > 0) {
+            depth -= 1;
+        } else if (depth == 0 && (ch == ',' || ch == ']')) {
+            Json_Tape_Range range = { item_begin, loc };
+            arena_da_append(arena, items, range);
+            item_begin = loc + 1;
+            if (ch == ']') {
+                *close = loc;
+                // NOTE(nic): `[]` has no items, the range found before the bracket is just whitespace
+                if (items->count == 1 && data[index->items[i - 1]] == '[') {
+                    items->count = 0;
+                }
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+typedef struct {
+    const Json_Tape_Parser *config;
+    const char *data;
+    Json_Tape_Range *ranges;
+    size_t count;
+    Json_Tape *tapes;
+    Arena arena;
+    Json_Result result;
+} Json_Tape_Worker;
+
+void *json_tape_worker_run(void *arg) {
+    Json_Tape_Worker *worker = arg;
+    worker->tapes = arena_alloc(&worker->arena, worker->count * sizeof(*worker->tapes));
+    for (size_t i = 0; i < worker->count; ++i) {
+        Json_Tape_Range range = worker->ranges[i];
+        Json_Tape_Parser parser = {0};
+        parser.key_id = worker->config->key_id;
+        parser.known_keys_only = worker->config->known_keys_only;
+        Json_Result result = json_tape_parser_run(&worker->arena, &parser, &worker->data[range.begin], range.end - range.begin);
+        if (result.failed) {
+            result.error_loc += range.begin;
+            worker->result = result;
+            break;
+        }
+        worker->tapes[i] = parser.tape;
+    }
+    return NULL;
+}
+
+// NOTE(nic): moves a tape parsed out of `source[begin..]` to the end of `tape`
+void json_tape_append_rebased(Arena *arena, Json_Tape *tape, Json_Tape *part, size_t begin) {
+    size_t base = tape->count;
+    json_tape_reserve(arena, tape, base + part->count);
+    memcpy(&tape->items[base], part->items, part->count * sizeof(*part->items));
+    tape->count += part->count;
+    for (size_t i = base; i < tape->count; ++i) {
+        Json_Tape_Entry *entry = &tape->items[i];
+        if (entry->kind == JSON_OBJ_STRING) {
+            entry->as.offset += (uint32_t)begin;
+        } else if (entry->kind == JSON_OBJ_DICT || entry->kind == JSON_OBJ_ARRAY) {
+            entry->as.end += (uint32_t)base;
+        }
+    }
+}
+
+Json_Result json_tape_parse_parallel(Arena *arena, Json_Tape_Parser *parser, const char *data, size_t size,
+                                     String_View split_key, size_t threads)
+{
+    assert(parser->buffer.count == 0);
+    String_View content = { data, size };
+    size_t open = 0, close = 0;
+    Json_Tape_Ranges items = {0};
+    Json_Structural_Index index = {0};
+
+    bool split = threads > 1 && size <= UINT32_MAX
+        && json_build_structural_index(arena, content, &index)
+        && json_tape_find_split(arena, &index, content, split_key, &open, &close, &items)
+        && items.count > 1;
+    if (split && parser->known_keys_only) {
+        split = parser->key_id != NULL && parser->key_id(split_key) != JSON_TAPE_KEY_UNKNOWN;
+    }
+    if (!split) {
+        return json_tape_parser_run(arena, parser, data, size);
+    }
+
+    // NOTE(nic): the parser takes everything up to and including the opening bracket of the array
+    parser->buffer = (String) { (char *)data, open + 1, size };
+    json_tape_parser_advance(arena, parser, false);
+    if (parser->result.failed || parser->stopped) {
+        return parser->result;
+    }
+    assert(parser->state == JSON_TAPE_EXPECT_VALUE_OR_CLOSE && parser->cursor == open + 1);
+    size_t array = parser->open.items[parser->open.count - 1];
+
+    if (threads > items.count) {
+        threads = items.count;
+    }
+    if (threads > JSON_TAPE_MAX_THREADS) {
+        threads = JSON_TAPE_MAX_THREADS;
+    }
+    Json_Tape_Worker workers[JSON_TAPE_MAX_THREADS] = {0};
+    pthread_t handles[JSON_TAPE_MAX_THREADS];
+    bool started[JSON_TAPE_MAX_THREADS] = {0};
+
+    // NOTE(nic): consecutive items go to the same worker, with roughly the same amount of bytes each
+    size_t per_worker = (close - open) / threads + 1;
+    size_t next = 0;
+    for (size_t w = 0; w < threads; ++w) {
+        Json_Tape_Worker *worker = &workers[w];
+        worker->config = parser;
+        worker->data = data;
+        worker->ranges = &items.items[next];
+        size_t bytes = 0;
+        while (next < items.count && (bytes < per_worker || w == threads - 1)) {
+            bytes += items.items[next].end - items.items[next].begin;
+            worker->count += 1;
+            next += 1;
+        }
+    }
+
+    // NOTE(nic): the calling thread takes the first share, if a thread can not be started its share runs here too
+    for (size_t w = 1; w < threads; ++w) {
+        started[w] = pthread_create(&handles[w], NULL, json_tape_worker_run, &workers[w]) == 0;
+    }
+    json_tape_worker_run(&workers[0]);
+    for (size_t w = 1; w < threads; ++w) {
+        if (started[w]) {
+            pthread_join(handles[w], NULL);
+        } else {
+            json_tape_worker_run(&workers[w]);
+        }
+    }
+
+    Json_Result result = {0};
+    size_t total = parser->tape.count;
+    for (size_t w = 0; w < threads; ++w) {
+        for (size_t i = 0; !workers[w].result.failed && i < workers[w].count; ++i) {
+            total += workers[w].tapes[i].count;
+        }
+    }
+    // NOTE(nic): room for whatever comes after the array too, which is usually next to nothing
+    json_tape_reserve(arena, &parser->tape, total + total/16);
+    for (size_t w = 0; w < threads; ++w) {
+        if (workers[w].result.failed && !result.failed) {
+            result = workers[w].result;
+        }
+        for (size_t i = 0; !result.failed && i < workers[w].count; ++i) {
+            json_tape_append_rebased(arena, &parser->tape, &workers[w].tapes[i], workers[w].ranges[i].begin);
+            parser->tape.items[array].size += 1;
+        }
+        arena_free(&workers[w].arena);
+    }
+    if (result.failed) {
+        parser->result = result;
+        return result;
+    }
+
+    // NOTE(nic): and carries on from the closing bracket as if it had parsed the items itself
+    parser->buffer.count = size;
+    parser->cursor = close;
+    parser->state = JSON_TAPE_EXPECT_COMMA_OR_CLOSE;
+    return json_tape_parser_finish(arena, parser);
+}
+
+size_t json_tape_skip(Json_Tape *tape, size_t index) {
+    assert(index < tape->count);
+    Json_Tape_Entry *entry = &tape->items[index];
+    if (entry->kind == JSON_OBJ_DICT || entry->kind == JSON_OBJ_ARRAY) {
+        return entry->as.end;
+    }
+    return index + 1;
+}
+
+size_t json_tape_dict_get(Json_Tape *tape, size_t dict, String_View key) {
+    assert(dict < tape->count);
+    assert(tape->items[dict].kind == JSON_OBJ_DICT);
+    size_t end = tape->items[dict].as.end;
+    size_t curr = dict + 1;
+    while (curr < end) {
+        if (json_tape_string_eq(tape, curr, key)) {
+            return curr + 1;
+        }
+        curr = json_tape_skip(tape, curr + 1);
+    }
+    return JSON_TAPE_NONE;
+}
+
+// NOTE(nic): only finds keys that were tagged while parsing, see Json_Tape_Parser
+size_t json_tape_dict_get_id(Json_Tape *tape, size_t dict, uint16_t key_id) {
+    assert(dict < tape->count);
+    assert(tape->items[dict].kind == JSON_OBJ_DICT);
+    assert(key_id != JSON_TAPE_KEY_UNKNOWN);
+    size_t end = tape->items[dict].as.end;
+    size_t curr = dict + 1;
+    while (curr < end) {
+        if (tape->items[curr].key_id == key_id) {
+            return curr + 1;
+        }
+        curr = json_tape_skip(tape, curr + 1);
+    }
+    return JSON_TAPE_NONE;
+}
+
+size_t json_tape_array_get(Json_Tape *tape, size_t array, size_t index) {
+    assert(array < tape->count);
+    assert(tape->items[array].kind == JSON_OBJ_ARRAY);
+    assert(index < tape->items[array].size);
+    size_t curr = array + 1;
+    for (size_t i = 0; i < index; ++i) {
+        curr = json_tape_skip(tape, curr);
+    }
+    return curr;
+}
+
+String_View json_tape_raw_string(Json_Tape *tape, size_t index) {
+    assert(index < tape->count);
+    Json_Tape_Entry *entry = &tape->items[index];
+    assert(entry->kind == JSON_OBJ_STRING);
+    return (String_View) { &tape->source.data[entry->as.offset], entry->size };
+}
+
+// NOTE(nic): compares the raw text, which is what you want for keys and enum like values
+bool json_tape_string_eq(Json_Tape *tape, size_t index, String_View sv) {
+    if (index == JSON_TAPE_NONE || tape->items[index].kind != JSON_OBJ_STRING) {
+        return false;
+    }
+    return sv_eq(json_tape_raw_string(tape, index), sv);
+}
+
+Json_Result json_tape_decode_string(Arena *arena, Json_Tape *tape, size_t index, String *out) {
+    Json_Object string = {0};
+    string.kind = JSON_OBJ_STRING;
+    string.flags = tape->items[index].flags;
+    String_View raw = json_tape_raw_string(tape, index);
+    string.as.string = (String) { (char *)raw.data, raw.size, 0 };
+    Json_Result result = json_string_decode(arena, &string);
+    *out = string.as.string;
+    return result;
+}
+
+size_t json_tape_write_at(Arena *arena, String *out, Json_Tape *tape, size_t index, Json_Write_Mode mode, size_t depth) {
+    assert(index < tape->count);
+    Json_Tape_Entry *entry = &tape->items[index];
+    if (entry->kind != JSON_OBJ_DICT && entry->kind != JSON_OBJ_ARRAY) {
+        Json_Object scalar = {0};
+        scalar.kind = entry->kind;
+        scalar.flags = entry->flags;
+        switch (entry->kind) {
+        case JSON_OBJ_BOOLEAN: scalar.as.boolean = entry->as.boolean; break;
+        case JSON_OBJ_INT64: scalar.as.int64 = entry->as.int64; break;
+        case JSON_OBJ_DECIMAL: scalar.as.decimal = entry->as.decimal; break;
+        case JSON_OBJ_STRING: {
+            String_View raw = json_tape_raw_string(tape, index);
+            scalar.as.string = (String) { (char *)raw.data, raw.size, 0 };
+        } break;
+        default: break;
+        }
+        json_write_obj(arena, out, &scalar, mode);
+        return index + 1;
+    }
+
+    bool dict = entry->kind == JSON_OBJ_DICT;
+    json_write_char(arena, out, dict ? '{' : '[');
+    size_t curr = index + 1;
+    while (curr < entry->as.end) {
+        if (curr > index + 1) {
+            json_write_char(arena, out, ',');
+        }
+        json_write_indent(arena, out, mode, depth + 1);
+        if (dict) {
+            curr = json_tape_write_at(arena, out, tape, curr, mode, depth + 1);
+            json_write_char(arena, out, ':');
+            if (mode == JSON_WRITE_PRETTY) {
+                json_write_char(arena, out, ' ');
+            }
+        }
+        curr = json_tape_write_at(arena, out, tape, curr, mode, depth + 1);
+    }
+    if (entry->as.end > index + 1) {
+        json_write_indent(arena, out, mode, depth);
+    }
+    json_write_char(arena, out, dict ? '}' : ']');
+    return entry->as.end;
+}
+
+void json_tape_write(Arena *arena, String *out, Json_Tape *tape, size_t index, Json_Write_Mode mode) {
+    (void)json_tape_write_at(arena, out, tape, index, mode, 0);
+}
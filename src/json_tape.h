@@ -0,0 +1,146 @@
+#ifndef JSON_TAPE_H_
+#define JSON_TAPE_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "./arena.h"
+#include "./utils.h"
+#include "./json.h"
+
+// NOTE(nic): a whole document flattened into one array, in the order values appear in the input.
+// A dict entry is followed by its key and value entries (key, value, key, value, ...), an array entry by
+// its items, and both store the index right past their last descendant so any subtree can be skipped in O(1).
+// Strings point into the parsed input, which has to outlive the tape.
+
+#define JSON_TAPE_NONE ((size_t)-1)
+
+// NOTE(nic): key ids come from the parser's `key_id` function, zero means the key was not recognized
+#define JSON_TAPE_KEY_UNKNOWN 0
+
+typedef uint16_t (*Json_Tape_Key_Id)(String_View key);
+
+typedef struct {
+    uint8_t kind;    // NOTE(nic): Json_Object_Kind
+    uint8_t flags;   // NOTE(nic): Json_String_Flags, strings only
+    uint16_t key_id; // NOTE(nic): dict keys only, sits in what would otherwise be padding
+    uint32_t size;   // NOTE(nic): bytes of a string, items of an array, pairs of a dict
+    union {
+        bool boolean;
+        int64_t int64;
+        double decimal;
+        uint32_t offset; // NOTE(nic): strings, where the raw text starts in the input
+        uint32_t end;    // NOTE(nic): dicts and arrays, index of the first entry after the container
+    } as;
+} Json_Tape_Entry;
+
+typedef struct {
+    Json_Tape_Entry *items;
+    size_t count;
+    size_t capacity;
+    String_View source;
+} Json_Tape;
+
+Json_Result json_tape_parse(Arena *arena, Json_Tape *tape, const char *data, size_t size);
+
+typedef enum {
+    JSON_TAPE_EXPECT_VALUE,
+    JSON_TAPE_EXPECT_VALUE_OR_CLOSE,
+    JSON_TAPE_EXPECT_KEY,
+    JSON_TAPE_EXPECT_KEY_OR_CLOSE,
+    JSON_TAPE_EXPECT_COLON,
+    JSON_TAPE_EXPECT_COMMA_OR_CLOSE,
+    JSON_TAPE_EXPECT_END,
+    JSON_TAPE_SKIP_VALUE,
+} Json_Tape_Parser_State;
+
+typedef struct {
+    size_t *items; // NOTE(nic): tape indices of the containers that are still open, innermost last
+    size_t count;
+    size_t capacity;
+} Json_Tape_Open;
+
+// NOTE(nic): whether each container open inside a value that is being skipped is a dict, innermost last
+typedef struct {
+    bool *items;
+    size_t count;
+    size_t capacity;
+} Json_Tape_Skip_Open;
+
+typedef struct Json_Tape_Parser Json_Tape_Parser;
+
+// NOTE(nic): called right after a dict or array is closed, while it is still the last item of `parser->open`,
+// so the open containers are the path to it. Returning true stops the parse there.
+typedef bool (*Json_Tape_On_Close)(void *user_data, Json_Tape_Parser *parser, size_t container);
+
+// NOTE(nic): called for every key that made it past `known_keys_only`, before it goes on the tape, while its dict
+// is the last item of `parser->open`. Returning false skips the pair as if the key was not recognized.
+typedef bool (*Json_Tape_On_Key)(void *user_data, Json_Tape_Parser *parser, String_View key, uint16_t key_id);
+
+// NOTE(nic): builds a tape out of input that arrives in pieces, e.g. straight off a socket.
+// Every feed is appended to `buffer`, which is the tape source, and parsed as far as it goes.
+// The tape is only complete after json_tape_parser_finish succeeds. Once `on_close` stops the parse
+// further feeds are ignored, and the containers that were still open end where the tape ends, their sizes
+// counting only the items that made it onto the tape.
+//
+// If `key_id` is set, every key is tagged with the id it gives for the raw key text as it is scanned.
+// If `known_keys_only` is set too, only pairs with a recognized key make it onto the tape, in dicts at any depth.
+// The values of every other pair are lexed and checked like the rest of the input, but nothing about them
+// goes on the tape.
+struct Json_Tape_Parser {
+    Json_Tape tape;
+    String buffer;
+    size_t cursor;
+    Json_Tape_Parser_State state;
+    Json_Tape_Open open;
+    Json_Result result; // NOTE(nic): sticky, once failed every call returns the same error
+
+    Json_Tape_On_Close on_close;
+    Json_Tape_On_Key on_key;
+    void *user_data; // NOTE(nic): handed to both hooks
+    bool stopped;
+
+    Json_Tape_Key_Id key_id;
+    bool known_keys_only;
+    bool skip_pair;                   // NOTE(nic): the last key was not kept, so neither is its value
+    Json_Tape_Parser_State skip_state; // NOTE(nic): what comes next inside the value being skipped
+    Json_Tape_Skip_Open skip_open;
+};
+
+// NOTE(nic): i3 trees average a bit under 8 input bytes per entry, guess a little lower than that
+// since coming up short means reallocating the whole tape
+#define JSON_TAPE_BYTES_PER_ENTRY_HINT 6
+
+// NOTE(nic): a zeroed parser is ready to be fed. If the input size is known up front,
+// reserving it before the first feed allocates the buffer once and the tape roughly once.
+void json_tape_parser_reserve(Arena *arena, Json_Tape_Parser *parser, size_t size_hint);
+Json_Result json_tape_parser_feed(Arena *arena, Json_Tape_Parser *parser, const char *data, size_t size);
+// NOTE(nic): like feeding, for `size` bytes that were written right past the end of `buffer` within its capacity,
+// e.g. straight off a socket after reserving, which saves copying them over
+Json_Result json_tape_parser_commit(Arena *arena, Json_Tape_Parser *parser, size_t size);
+Json_Result json_tape_parser_finish(Arena *arena, Json_Tape_Parser *parser);
+
+#define JSON_TAPE_MAX_THREADS 16
+
+// NOTE(nic): parses a whole document in place, like reserving, feeding it in one go and finishing would, except
+// that the items of the array under `split_key` in the root dict are parsed on up to `threads` threads, each
+// with an arena of its own, and then stitched into the tape. The hooks never see the keys and containers in those
+// items. Documents of any other shape are parsed on the calling thread.
+// `data` is the tape source, it has to outlive it.
+Json_Result json_tape_parse_parallel(Arena *arena, Json_Tape_Parser *parser, const char *data, size_t size,
+                                     String_View split_key, size_t threads);
+
+size_t json_tape_skip(Json_Tape *tape, size_t index);
+size_t json_tape_dict_get(Json_Tape *tape, size_t dict, String_View key);
+size_t json_tape_dict_get_id(Json_Tape *tape, size_t dict, uint16_t key_id);
+size_t json_tape_array_get(Json_Tape *tape, size_t array, size_t index);
+
+String_View json_tape_raw_string(Json_Tape *tape, size_t index);
+bool json_tape_string_eq(Json_Tape *tape, size_t index, String_View sv);
+Json_Result json_tape_decode_string(Arena *arena, Json_Tape *tape, size_t index, String *out);
+
+// NOTE(nic): same output as json_write_obj would give for the value at `index`
+void json_tape_write(Arena *arena, String *out, Json_Tape *tape, size_t index, Json_Write_Mode mode);
+
+#endif // JSON_TAPE_H_
@@ -1,4 +1,4 @@
-// NOTE(nic): we need to define this in order to have `popen` function
+// NOTE(nic): we need to define this in order to have `posix_spawn_file_actions_adddup2` function
 #define _POSIX_C_SOURCE 200809L
 
 #include <stdio.h>
@@ -10,17 +10,41 @@
 #include <assert.h>
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <spawn.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
 
 #include "./json.h"
+#include "./json_tape.h"
+#include "./json_query.h"
+#include "./i3_ipc.h"
 #include "./utils.h"
 
 #define ARENA_IMPLEMENTATION
 #include "./arena.h"
 
-#define I3_MAGIC "i3-ipc"
-#define I3_HEADER_SIZE 14 // in bytes
+#define DAEMON_SOCKET_NAME "dmenu_scratch.sock"
+
+// NOTE(nic): a daemon that takes longer than this to hand over the list is taken for stuck
+#define DAEMON_RECEIVE_TIMEOUT_MS 1000
+
+// NOTE(nic): once this many bytes of stale names pile up in the model arena it gets compacted
+#define MODEL_GARBAGE_LIMIT (64*1024)
+
+// NOTE(nic): how much of a big reply is read off the socket before it is handed to the parser
+#define RECEIVE_CHUNK_SIZE (64*1024)
+
+// NOTE(nic): trees at least this big are received whole and parsed one output per thread, smaller ones
+// are parsed while they arrive, which usually stops early once the scratchpad is seen
+#ifndef PARALLEL_PARSE_MIN_SIZE
+#define PARALLEL_PARSE_MIN_SIZE (8*1024*1024)
+#endif
 
 void str_append_uint32_bytes_le(Arena *arena, String *str, uint32_t n) {
     for (size_t i = 0; i < sizeof(uint32_t); ++i) {
@@ -29,6 +53,11 @@ void str_append_uint32_bytes_le(Arena *arena, String *str, uint32_t n) {
     }
 }
 
+void str_append_uint64_bytes_le(Arena *arena, String *str, uint64_t n) {
+    str_append_uint32_bytes_le(arena, str, (uint32_t)(n & 0xFFFFFFFF));
+    str_append_uint32_bytes_le(arena, str, (uint32_t)(n >> 32));
+}
+
 typedef struct {
     const uint8_t *data;
     size_t size;
@@ -65,24 +94,96 @@ uint32_t reader_read_uint32_bytes_le(Bytes_Reader *reader) {
     return n;
 }
 
-Json_Dict *i3_find_scratchpad(Json_Array *nodes) {
-    for (size_t i = 0; i < nodes->count; ++i) {
-        Json_Dict *dict = json_array_get_dict(nodes, i);
-        Json_Array *subnodes = json_dict_get_array(dict, JSON_OBJ_STR_FROM_CSTR_LIT("nodes"));
-        if (subnodes != NULL) {
-            Json_Dict *scratchpad = i3_find_scratchpad(subnodes);
-            if (scratchpad != NULL) {
-                return scratchpad;
+uint64_t reader_read_uint64_bytes_le(Bytes_Reader *reader) {
+    uint64_t lo = reader_read_uint32_bytes_le(reader);
+    uint64_t hi = reader_read_uint32_bytes_le(reader);
+    return lo | (hi << 32);
+}
+
+bool send_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t bytes_sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (bytes_sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += bytes_sent;
+        size -= bytes_sent;
+    }
+    return true;
+}
+
+// NOTE(nic): reads until the other side closes the connection or pipe
+bool read_all(Arena *arena, int fd, String *str) {
+    char buffer[4096];
+    while (true) {
+        ssize_t bytes_received = read(fd, buffer, sizeof(buffer));
+        if (bytes_received < 0) {
+            if (errno == EINTR) {
+                continue;
             }
+            return false;
+        }
+        if (bytes_received == 0) {
+            return true;
         }
+        arena_da_append_many(arena, str, buffer, (size_t)bytes_received);
+    }
+}
 
-        String *node_type = json_dict_get_string(dict, JSON_OBJ_STR_FROM_CSTR_LIT("type"));
-        String *node_name = json_dict_get_string(dict, JSON_OBJ_STR_FROM_CSTR_LIT("name"));
-        if (str_eq_cstr(node_type, "workspace") && str_eq_cstr(node_name, "__i3_scratch")) {
-            return dict;
+// NOTE(nic): like send_all for pipes, in as few writev calls as the system allows
+bool write_iov(int fd, struct iovec *iov, size_t iov_count) {
+    long iov_max = sysconf(_SC_IOV_MAX);
+    if (iov_max <= 0) {
+        // NOTE(nic): the least POSIX allows, when there is no limit to speak of
+        iov_max = 16;
+    }
+    while (iov_count > 0) {
+        int count = (iov_count < (size_t)iov_max) ? (int)iov_count : (int)iov_max;
+        ssize_t bytes_written = writev(fd, iov, count);
+        if (bytes_written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        size_t written = (size_t)bytes_written;
+        while (iov_count > 0 && written >= iov[0].iov_len) {
+            written -= iov[0].iov_len;
+            iov += 1;
+            iov_count -= 1;
+        }
+        if (iov_count > 0) {
+            iov[0].iov_base = (char *)iov[0].iov_base + written;
+            iov[0].iov_len -= written;
         }
     }
-    return NULL;
+    return true;
+}
+
+// NOTE(nic): returns -1 instead of exiting so callers can decide what a failed connection means
+int unix_connect(const char *socket_path) {
+    struct sockaddr_un sockaddr = {0};
+    if (strlen(socket_path) >= sizeof(sockaddr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    sockaddr.sun_family = AF_UNIX;
+    strcpy(sockaddr.sun_path, socket_path);
+
+    int socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket_fd < 0) {
+        return -1;
+    }
+    if (connect(socket_fd, (struct sockaddr*)&sockaddr, sizeof(sockaddr)) < 0) {
+        int saved_errno = errno;
+        close(socket_fd);
+        errno = saved_errno;
+        return -1;
+    }
+    return socket_fd;
 }
 
 typedef struct {
@@ -96,153 +197,296 @@ typedef struct {
     size_t capacity;
 } Windows;
 
-void i3_get_node_windows_impl(Arena *arena, Windows *windows, Json_Dict *curr, Json_Dict *parent) {
-    Json_Array *nodes = json_dict_get_array(curr, JSON_OBJ_STR_FROM_CSTR_LIT("nodes"));
-    Json_Array *floating_nodes = json_dict_get_array(curr, JSON_OBJ_STR_FROM_CSTR_LIT("floating_nodes"));
-
-    if (parent != NULL) {
-        String *node_type = json_dict_get_string(curr, JSON_OBJ_STR_FROM_CSTR_LIT("type"));
-        String *parent_type = json_dict_get_string(parent, JSON_OBJ_STR_FROM_CSTR_LIT("type"));
-        if (nodes->count <= 0
-            && floating_nodes->count <= 0
-            && str_eq_cstr(node_type, "con")
-            && !str_eq_cstr(parent_type, "dockarea"))
-        {
-            Json_Dict *window_props = json_dict_get_dict(curr, JSON_OBJ_STR_FROM_CSTR_LIT("window_properties"));
-            int64_t *window_id = json_dict_get_int64(curr, JSON_OBJ_STR_FROM_CSTR_LIT("id"));
+// NOTE(nic): the children of a node stay on the tape, they are only decoded once a walk gets to them
+typedef struct {
+    size_t array; // NOTE(nic): tape index of the array, JSON_TAPE_NONE if the key is missing
+    size_t count;
+} I3_Nodes;
 
-            // NOTE(nic): yes, we use the class as the window name, don't ask questions
-            String *window_name = json_dict_get_string(window_props, JSON_OBJ_STR_FROM_CSTR_LIT("class"));
-            if (window_name == NULL) {
-                window_name = json_dict_get_string(window_props, JSON_OBJ_STR_FROM_CSTR_LIT("title"));
-            }
-            assert(window_name != NULL);
+// NOTE(nic): the part of the i3 tree we care about, X(key, field, type, decode) where `decode` turns
+// the value of `key` on the tape into `type`. The window properties are a nested dict with their own schema,
+// but their fields end up right in the node.
+#define I3_NODE_SCHEMA                                                  \
+    X(id, id, int64_t, i3_decode_int64)                                 \
+    X(type, type, String_View, i3_decode_raw_string)                    \
+    X(name, name, String_View, i3_decode_raw_string)                    \
+    X(nodes, children, I3_Nodes, i3_decode_nodes)                       \
+    X(floating_nodes, floating_children, I3_Nodes, i3_decode_nodes)
+
+#define I3_WINDOW_PROPERTIES_SCHEMA                                     \
+    X(class, window_class, String, i3_decode_string)                    \
+    X(title, window_title, String, i3_decode_string)
+
+typedef enum {
+#define X(key, field, type, decode) I3_KEY_##key,
+    I3_NODE_SCHEMA
+    I3_WINDOW_PROPERTIES_SCHEMA
+#undef X
+    I3_KEY_window_properties,
+    I3_KEY_COUNT,
+    I3_KEY_UNKNOWN = I3_KEY_COUNT,
+} I3_Key;
+
+#define I3_KEY_BIT(key) (1u << I3_KEY_##key)
+
+String_View i3_key_names[I3_KEY_COUNT] = {
+#define X(key, field, type, decode) [I3_KEY_##key] = SV_STATIC(#key),
+    I3_NODE_SCHEMA
+    I3_WINDOW_PROPERTIES_SCHEMA
+#undef X
+    [I3_KEY_window_properties] = SV_STATIC("window_properties"),
+};
+
+typedef struct {
+#define X(key, field, type, decode) type field;
+    I3_NODE_SCHEMA
+    I3_WINDOW_PROPERTIES_SCHEMA
+#undef X
+    uint32_t present; // NOTE(nic): I3_KEY_BIT of every field that was there with the right kind
+} I3_Node;
+
+// NOTE(nic): perfect hash over the schema keys, (second char ^ length) % 16 puts every one of them
+// in a slot of its own. The slots are filled from the schema by i3_key_slots_init, which refuses to go on
+// if a new key lands in a taken slot.
+#define I3_KEY_SLOTS 16
+#define I3_KEY_HASH(data, size) ((((uint8_t)(data)[1]) ^ (size)) & (I3_KEY_SLOTS - 1))
 
-            size_t window_index = windows->count + 1;
-            String str = {0};
-            str_append_fmt(arena, &str, "%d. ", window_index);
-            arena_da_append_many(arena, &str, window_name->items, window_name->count);
+I3_Key i3_key_slots[I3_KEY_SLOTS];
 
-            String_View actual_window_name = (String_View) { str.items, str.count };
-            Window window = { *window_id, actual_window_name };
-            arena_da_append(arena, windows, window);
+void i3_key_slots_init(void) {
+    for (size_t i = 0; i < I3_KEY_SLOTS; ++i) {
+        i3_key_slots[i] = I3_KEY_UNKNOWN;
+    }
+    for (size_t i = 0; i < I3_KEY_COUNT; ++i) {
+        String_View name = i3_key_names[i];
+        size_t slot = (name.size >= 2) ? I3_KEY_HASH(name.data, name.size) : 0;
+        if (name.size < 2 || i3_key_slots[slot] != I3_KEY_UNKNOWN) {
+            fprintf(stderr, "Error: i3 key `%.*s` has no slot of its own, I3_KEY_HASH needs changing\n",
+                    (int)name.size, name.data);
+            exit(1);
         }
+        i3_key_slots[slot] = (I3_Key)i;
     }
+}
 
-    for (size_t i = 0; i < nodes->count; ++i) {
-        Json_Dict *subnode = json_array_get_dict(nodes, i);
-        i3_get_node_windows_impl(arena, windows, subnode, curr);
+I3_Key i3_key_lookup(String_View key) {
+    if (key.size < 2) {
+        return I3_KEY_UNKNOWN;
     }
-    for (size_t i = 0; i < floating_nodes->count; ++i) {
-        Json_Dict *subnode = json_array_get_dict(floating_nodes, i);
-        i3_get_node_windows_impl(arena, windows, subnode, curr);
+    I3_Key candidate = i3_key_slots[I3_KEY_HASH(key.data, key.size)];
+    if (candidate == I3_KEY_UNKNOWN || !sv_eq(i3_key_names[candidate], key)) {
+        return I3_KEY_UNKNOWN;
     }
+    return candidate;
 }
 
-Windows i3_get_scratchpad_windows(Arena *arena, Json_Dict *node) {
-    Windows windows = {0};
-    i3_get_node_windows_impl(arena, &windows, node, NULL);
-    return windows;
+// NOTE(nic): tape key ids are the I3_Key plus one, as zero is JSON_TAPE_KEY_UNKNOWN
+#define I3_TAPE_KEY_ID(key) ((uint16_t)(I3_KEY_##key + 1))
+
+uint16_t i3_tape_key_id(String_View key) {
+    I3_Key found = i3_key_lookup(key);
+    return (found == I3_KEY_UNKNOWN) ? JSON_TAPE_KEY_UNKNOWN : (uint16_t)(found + 1);
 }
 
-Json_Result i3_receive_message(Arena *arena, int socket_fd, Json_Object *object) {
-    uint8_t header[I3_HEADER_SIZE];
-    ssize_t header_bytes_received = recv(socket_fd, header, I3_HEADER_SIZE, MSG_WAITALL);
-    if (header_bytes_received != I3_HEADER_SIZE) {
-        fprintf(stderr, "Error: could not receive message: %s\n", strerror(errno));
-        exit(1);
+// NOTE(nic): keys of GET_TREE are tagged while parsing, event payloads are parsed in one go and are not
+I3_Key i3_tape_key(Json_Tape *tape, size_t key) {
+    uint16_t key_id = tape->items[key].key_id;
+    if (key_id != JSON_TAPE_KEY_UNKNOWN) {
+        return (I3_Key)(key_id - 1);
     }
+    return i3_key_lookup(json_tape_raw_string(tape, key));
+}
 
-    Bytes_Reader reader = { header, I3_HEADER_SIZE, 0 };
-    (void)reader_read_bytes(&reader, strlen(I3_MAGIC));
-    uint32_t message_size = reader_read_uint32_bytes_le(&reader);
-    (void)reader_read_uint32_bytes_le(&reader);
-
-    String message = str_with_cap(arena, message_size);
-    message.count = message_size;
+bool i3_decode_int64(Arena *arena, Json_Tape *tape, size_t value, int64_t *out) {
+    (void)arena;
+    if (tape->items[value].kind != JSON_OBJ_INT64) {
+        return false;
+    }
+    *out = tape->items[value].as.int64;
+    return true;
+}
 
-    ssize_t message_bytes_received = recv(socket_fd, message.items, message_size, 0);
-    if (message_bytes_received != message_size) {
-        fprintf(stderr, "Error: could not receive message: %s\n", strerror(errno));
-        exit(1);
+// NOTE(nic): for enum like values that are only ever compared
+bool i3_decode_raw_string(Arena *arena, Json_Tape *tape, size_t value, String_View *out) {
+    (void)arena;
+    if (tape->items[value].kind != JSON_OBJ_STRING) {
+        return false;
     }
+    *out = json_tape_raw_string(tape, value);
+    return true;
+}
 
-    return json_parse(arena, object, message.items, message.count);
+bool i3_decode_string(Arena *arena, Json_Tape *tape, size_t value, String *out) {
+    if (tape->items[value].kind != JSON_OBJ_STRING) {
+        return false;
+    }
+    // NOTE(nic): strings that do not decode are shown as they came
+    (void)json_tape_decode_string(arena, tape, value, out);
+    return true;
 }
 
-typedef struct {
-    int failed;
-    const char *error;
-    ssize_t index;
-} Prompt_Result;
+void i3_decode_window_properties(Arena *arena, Json_Tape *tape, size_t dict, I3_Node *node) {
+    if (tape->items[dict].kind != JSON_OBJ_DICT) {
+        return;
+    }
+    size_t end = tape->items[dict].as.end;
+    for (size_t key = dict + 1; key < end; key = json_tape_skip(tape, key + 1)) {
+        switch (i3_tape_key(tape, key)) {
+#define X(key_, field, type, decode)                                        \
+        case I3_KEY_##key_:                                                 \
+            if (decode(arena, tape, key + 1, &node->field)) {               \
+                node->present |= I3_KEY_BIT(key_);                          \
+            }                                                               \
+            break;
+        I3_WINDOW_PROPERTIES_SCHEMA
+#undef X
+        default:
+            break;
+        }
+    }
+}
 
-Prompt_Result prompt_user(Arena *arena, Windows *windows) {
-    Prompt_Result result = {0};
-    result.index = -1;
+bool i3_decode_nodes(Arena *arena, Json_Tape *tape, size_t value, I3_Nodes *out) {
+    (void)arena;
+    if (tape->items[value].kind != JSON_OBJ_ARRAY) {
+        return false;
+    }
+    out->array = value;
+    out->count = tape->items[value].size;
+    return true;
+}
 
-    size_t size = 0;
-    String cmd = {0};
-    str_append_cstr(arena, &cmd, "echo \"");
-    for (size_t i = 0; i < windows->count; ++i) {
-        if (windows->items[i].name.size > size) {
-            size = windows->items[i].name.size;
-        }
-        str_append_sv(arena, &cmd, windows->items[i].name);
-        if (i < windows->count - 1) {
-            str_append_cstr(arena, &cmd, "\\n");
+// NOTE(nic): one pass over the pairs of the dict fills every field, missing children are left empty
+bool i3_decode_node(Arena *arena, Json_Tape *tape, size_t dict, I3_Node *node) {
+    if (tape->items[dict].kind != JSON_OBJ_DICT) {
+        return false;
+    }
+    *node = (I3_Node) {0};
+    node->children.array = JSON_TAPE_NONE;
+    node->floating_children.array = JSON_TAPE_NONE;
+    size_t end = tape->items[dict].as.end;
+    for (size_t key = dict + 1; key < end; key = json_tape_skip(tape, key + 1)) {
+        switch (i3_tape_key(tape, key)) {
+#define X(key_, field, type, decode)                                        \
+        case I3_KEY_##key_:                                                 \
+            if (decode(arena, tape, key + 1, &node->field)) {               \
+                node->present |= I3_KEY_BIT(key_);                          \
+            }                                                               \
+            break;
+        I3_NODE_SCHEMA
+#undef X
+        case I3_KEY_window_properties:
+            i3_decode_window_properties(arena, tape, key + 1, node);
+            break;
+        default:
+            break;
         }
     }
-    str_append_cstr(arena, &cmd, "\" | ");
-    str_append_cstr(arena, &cmd, "dmenu -i -p \"Window to bring back from the Shadow Realm\"");
-    str_append_null(arena, &cmd);
-
-    printf("Executing the folowing command:\n");
-    printf("%s\n", cmd.items);
+    return true;
+}
 
-    FILE *out = popen(cmd.items, "r");
-    if (out == NULL) {
-        result.failed = true;
-        result.error = strerror(errno);
-        goto cleanup;
+// NOTE(nic): yes, we use the class as the window name, don't ask questions
+bool i3_node_window(I3_Node *node, Window *window) {
+    if (!(node->present & I3_KEY_BIT(id))) {
+        return false;
+    }
+    String *name = NULL;
+    if (node->present & I3_KEY_BIT(class)) {
+        name = &node->window_class;
+    } else if (node->present & I3_KEY_BIT(title)) {
+        name = &node->window_title;
+    } else {
+        return false;
     }
+    window->id = node->id;
+    window->name = (String_View) { name->items, name->count };
+    return true;
+}
 
-    char *selected_window = arena_alloc(arena, size + 1);
-    memset(selected_window, 0, size + 1);
+typedef struct {
+    size_t dict;
+    bool root;
+    String_View parent_type; // NOTE(nic): decoded when the parent was visited, not looked up again
+} I3_Window_Frame;
+
+typedef struct {
+    I3_Window_Frame *items;
+    size_t count;
+    size_t capacity;
+} I3_Window_Frames;
 
-    char ch = getc(out);
-    if (ch == EOF) {
-        // NOTE(nic): user closed dmenu without selecting a window
-        goto cleanup;
+void i3_push_children(Arena *arena, I3_Window_Frames *stack, Json_Tape *tape, I3_Nodes *children, String_View type) {
+    if (children->array == JSON_TAPE_NONE) {
+        return;
+    }
+    size_t base = stack->count;
+    size_t item = children->array + 1;
+    for (size_t i = 0; i < children->count; ++i) {
+        arena_da_append(arena, stack, ((I3_Window_Frame) { item, false, type }));
+        item = json_tape_skip(tape, item);
     }
-    for (size_t i = 0; ch != '\n' && ch != '\0'; ++i) {
-        selected_window[i] = ch;
-        ch = getc(out);
+    // NOTE(nic): the tape only goes forward, so the items are pushed in order and flipped to be popped in order
+    for (size_t i = base, j = stack->count; i + 1 < j; ++i, --j) {
+        I3_Window_Frame temp = stack->items[i];
+        stack->items[i] = stack->items[j - 1];
+        stack->items[j - 1] = temp;
     }
+}
 
-    String_View sv = SV(selected_window);
-    for (size_t i = 0; i < windows->count; ++i) {
-        if (sv_eq(windows->items[i].name, sv)) {
-            result.index = i;
-            goto cleanup;
+// NOTE(nic): decodes every node under `dict` exactly once, straight off the tape, and keeps the leaves that are
+// windows. They come out in the order a depth first walk meets them, tiled children before floating ones.
+// Split layouts can nest as deep as the user likes, so the walk has a stack of its own instead of recursing.
+Windows i3_get_container_windows(Arena *arena, Json_Tape *tape, size_t dict) {
+    Windows windows = {0};
+    I3_Window_Frames stack = {0};
+    arena_da_append(arena, &stack, ((I3_Window_Frame) { dict, true, {0} }));
+    while (stack.count > 0) {
+        I3_Window_Frame frame = stack.items[--stack.count];
+        I3_Node node = {0};
+        if (!i3_decode_node(arena, tape, frame.dict, &node)) {
+            continue;
         }
+
+        Window window = {0};
+        if (!frame.root
+            && node.children.count == 0
+            && node.floating_children.count == 0
+            && sv_eq(node.type, SV("con"))
+            && !sv_eq(frame.parent_type, SV("dockarea"))
+            && i3_node_window(&node, &window))
+        {
+            arena_da_append(arena, &windows, window);
+        }
+
+        i3_push_children(arena, &stack, tape, &node.floating_children, node.type);
+        i3_push_children(arena, &stack, tape, &node.children, node.type);
     }
+    return windows;
+}
 
-cleanup:
-    if (out != NULL) {
-        pclose(out);
+void i3_send_message(I3_Ipc *ipc, I3_Message_Type type, String_View payload) {
+    if (!i3_ipc_send(ipc, type, payload)) {
+        fprintf(stderr, "Error: could not send message to i3: %s\n", ipc->error);
+        exit(1);
     }
-    return result;
 }
 
-void show_notification(Arena *arena, const char *message) {
-    String cmd = {0};
-    str_append_fmt(arena, &cmd, "dunstify 'dmenu_scratchpad' '%s' -t 2000", message);
-    str_append_null(arena, &cmd);
-    // NOTE(nic): we don't particularly care if this fails
-    system(cmd.items);
+String_View i3_receive_reply(I3_Ipc *ipc, I3_Message_Type type) {
+    String_View payload = {0};
+    if (!i3_ipc_receive_reply(ipc, type, &payload)) {
+        fprintf(stderr, "Error: could not receive message: %s\n", ipc->error);
+        exit(1);
+    }
+    return payload;
 }
 
-int main(void) {
+// NOTE(nic): strings in `object` point into the receive buffer of `ipc`, they go stale with the next receive
+Json_Result i3_receive_message(Arena *arena, I3_Ipc *ipc, I3_Message_Type type, Json_Object *object) {
+    String_View payload = i3_receive_reply(ipc, type);
+    return json_parse(arena, object, payload.data, payload.size);
+}
+
+I3_Ipc i3_connect(void) {
     const char *socket_path = getenv("I3SOCK");
     if (socket_path == NULL) {
         fprintf(stderr, "Error: could not find i3 socket path\n");
@@ -250,104 +494,850 @@ int main(void) {
     }
     printf("Socket path: %s\n", socket_path);
 
-    int socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    int socket_fd = unix_connect(socket_path);
     if (socket_fd < 0) {
-        fprintf(stderr, "Error: could not create socket\n");
+        fprintf(stderr, "Error: could not connect to i3: %s\n", strerror(errno));
+        exit(1);
+    }
+    return i3_ipc_from_fd(socket_fd);
+}
+
+// NOTE(nic): the tree is parsed chunk by chunk as it comes in, so parsing mostly
+// overlaps with i3 still writing the rest of it
+// NOTE(nic): once `on_close` stops the parse, the rest of the message is still read (it has to be,
+// the socket is used again afterwards) but goes straight to the bin
+// NOTE(nic): the body of a GET_TREE reply whose header was already received
+Json_Result i3_receive_tape(Arena *arena, I3_Ipc *ipc, I3_Ipc_Header header, Json_Tape_Parser *parser) {
+    if (header.size >= PARALLEL_PARSE_MIN_SIZE) {
+        long threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads > 1) {
+            // NOTE(nic): the tape borrows its strings from the input, so it gets its own copy and not the ipc buffer
+            char *data = arena_alloc(arena, header.size);
+            if (!i3_ipc_read_all(ipc, data, header.size)) {
+                fprintf(stderr, "Error: could not receive message: %s\n", ipc->error);
+                exit(1);
+            }
+            return json_tape_parse_parallel(arena, parser, data, header.size, SV("nodes"), threads);
+        }
+    }
+
+    // NOTE(nic): read straight into the parser's buffer, a chunk at a time so parsing can start early
+    json_tape_parser_reserve(arena, parser, header.size);
+    size_t total_received = 0;
+    while (total_received < header.size) {
+        size_t wanted = header.size - total_received;
+        if (wanted > RECEIVE_CHUNK_SIZE) {
+            wanted = RECEIVE_CHUNK_SIZE;
+        }
+        size_t received = 0;
+        if (!i3_ipc_read(ipc, parser->buffer.items + parser->buffer.count, wanted, &received)) {
+            fprintf(stderr, "Error: could not receive message: %s\n", ipc->error);
+            exit(1);
+        }
+        total_received += received;
+        Json_Result result = json_tape_parser_commit(arena, parser, received);
+        if (result.failed) {
+            // NOTE(nic): callers exit on parse errors, the rest of the message does not matter
+            return result;
+        }
+    }
+
+    return json_tape_parser_finish(arena, parser);
+}
+
+// NOTE(nic): root -> outputs -> content containers -> workspaces. The parse stops as soon as the scratchpad
+// workspace is complete, which is nearly right away when i3 puts the `__i3` output first.
+#define I3_SCRATCHPAD_QUERY "nodes[*].nodes[*].nodes[type=workspace,name=__i3_scratch]"
+
+// NOTE(nic): compiled once at startup, every GET_TREE reply after that runs the same query
+Json_Query i3_scratchpad_query_compile(Arena *arena) {
+    Json_Query query = {0};
+    Json_Result result = json_query_compile(arena, &query, SV(I3_SCRATCHPAD_QUERY), i3_tape_key_id);
+    if (result.failed) {
+        fprintf(stderr, "Error: could not compile `%s` at %zu: %s\n", I3_SCRATCHPAD_QUERY, result.error_loc, result.error);
+        exit(1);
+    }
+    return query;
+}
+
+Windows i3_receive_scratchpad_windows(Arena *arena, I3_Ipc *ipc, I3_Ipc_Header header, Json_Query *query) {
+    Json_Tape_Parser parser = {0};
+    Json_Query_Stream stream = {0};
+    json_query_stream_attach(&stream, query, &parser);
+    // NOTE(nic): only what the schema reads is kept, rects, marks, focus lists, ... are skipped while parsing
+    parser.key_id = i3_tape_key_id;
+    parser.known_keys_only = true;
+    Json_Result result = i3_receive_tape(arena, ipc, header, &parser);
+    Json_Tape tape = parser.tape;
+    if (result.failed) {
+        fprintf(stderr, "Json parser error at %zu: %s\n", result.error_loc, result.error);
+        exit(1);
+    }
+    if (tape.items[0].kind != JSON_OBJ_DICT) {
+        fprintf(stderr, "Error: could not find i3 nodes\n");
+        exit(1);
+    }
+
+    size_t scratchpad = stream.match;
+    if (scratchpad == JSON_TAPE_NONE) {
+        scratchpad = json_query_tape_first(query, &tape, 0);
+    }
+    if (scratchpad == JSON_TAPE_NONE) {
+        fprintf(stderr, "Error: could not find i3 scratchpad\n");
         exit(1);
     }
 
+    return i3_get_container_windows(arena, &tape, scratchpad);
+}
+
+Windows i3_fetch_scratchpad_windows(Arena *arena, I3_Ipc *ipc, Json_Query *query) {
+    i3_send_message(ipc, I3_MSG_GET_TREE, SV(""));
+
+    I3_Ipc_Header header = {0};
+    if (!i3_ipc_receive_header(ipc, &header)) {
+        fprintf(stderr, "Error: could not receive message: %s\n", ipc->error);
+        exit(1);
+    }
+    if (header.type != I3_MSG_GET_TREE) {
+        fprintf(stderr, "Error: expected a reply to GET_TREE, got message type %u\n", header.type);
+        exit(1);
+    }
+    return i3_receive_scratchpad_windows(arena, ipc, header, query);
+}
+
+// NOTE(nic): wire format between daemon and client is
+// u32 count, then for every window: u64 id, u32 name size, name bytes (all little endian)
+void windows_serialize(Arena *arena, String *out, Windows *windows) {
+    str_append_uint32_bytes_le(arena, out, (uint32_t)windows->count);
+    for (size_t i = 0; i < windows->count; ++i) {
+        Window *window = &windows->items[i];
+        str_append_uint64_bytes_le(arena, out, (uint64_t)window->id);
+        str_append_uint32_bytes_le(arena, out, (uint32_t)window->name.size);
+        str_append_sv(arena, out, window->name);
+    }
+}
+
+bool windows_deserialize(Arena *arena, String *data, Windows *windows) {
+    Bytes_Reader reader = reader_from_str(data);
+    if (reader.size < sizeof(uint32_t)) {
+        return false;
+    }
+    uint32_t count = reader_read_uint32_bytes_le(&reader);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (reader.cursor + sizeof(uint64_t) + sizeof(uint32_t) > reader.size) {
+            return false;
+        }
+        Window window = {0};
+        window.id = (int64_t)reader_read_uint64_bytes_le(&reader);
+        uint32_t name_size = reader_read_uint32_bytes_le(&reader);
+        if (reader.cursor + name_size > reader.size) {
+            return false;
+        }
+        Bytes_View name = reader_read_bytes(&reader, name_size);
+        window.name = (String_View) { (const char *)name.data, name.size };
+        arena_da_append(arena, windows, window);
+    }
+    return true;
+}
+
+const char *daemon_socket_path(Arena *arena) {
+    const char *socket_path = getenv("DMENU_SCRATCH_SOCK");
+    if (socket_path != NULL) {
+        return socket_path;
+    }
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir != NULL) {
+        return arena_sprintf(arena, "%s/%s", runtime_dir, DAEMON_SOCKET_NAME);
+    }
+    return arena_sprintf(arena, "/tmp/dmenu_scratch.%d.sock", (int)getuid());
+}
+
+int daemon_listen(const char *socket_path) {
     struct sockaddr_un sockaddr = {0};
+    if (strlen(socket_path) >= sizeof(sockaddr.sun_path)) {
+        fprintf(stderr, "Error: daemon socket path is too long: %s\n", socket_path);
+        exit(1);
+    }
     sockaddr.sun_family = AF_UNIX;
     strcpy(sockaddr.sun_path, socket_path);
 
-    int conn_success = connect(socket_fd, (struct sockaddr*)&sockaddr, sizeof(sockaddr));
-    if (conn_success < 0) {
-        fprintf(stderr, "Error: could not connect to i3: %s\n", strerror(errno));
+    int socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket_fd < 0) {
+        fprintf(stderr, "Error: could not create socket\n");
         exit(1);
     }
 
-    Arena arena = {0};
-    {
-        String packet = {0};
-        str_append_cstr(&arena, &packet, I3_MAGIC);
-        str_append_uint32_bytes_le(&arena, &packet, 0);
-        str_append_uint32_bytes_le(&arena, &packet, 4);
+    // NOTE(nic): a previous daemon that got killed leaves its socket file behind, nobody answers on that one.
+    // One that does answer is still running and keeps the socket.
+    int running_fd = unix_connect(socket_path);
+    if (running_fd >= 0) {
+        close(running_fd);
+        fprintf(stderr, "Error: a daemon is already listening on %s\n", socket_path);
+        exit(1);
+    }
+    if (errno == ECONNREFUSED) {
+        unlink(socket_path);
+    }
+    if (bind(socket_fd, (struct sockaddr*)&sockaddr, sizeof(sockaddr)) < 0) {
+        fprintf(stderr, "Error: could not bind daemon socket %s: %s\n", socket_path, strerror(errno));
+        exit(1);
+    }
+    if (listen(socket_fd, 8) < 0) {
+        fprintf(stderr, "Error: could not listen on daemon socket: %s\n", strerror(errno));
+        exit(1);
+    }
+    return socket_fd;
+}
 
-        ssize_t bytes_sent = send(socket_fd, packet.items, packet.count, 0);
-        if (bytes_sent < 0) {
-            fprintf(stderr, "Error: could not send message to i3: %s\n", strerror(errno));
+// NOTE(nic): sends `requests` on the event connection, a GET_TREE last, and takes the scratchpad windows out of
+// its reply. i3 answers in order, so the events that come before the tree happened before it was taken and are
+// already in it, they are dropped. The ones after it are left on the socket for whoever reads the events next.
+Windows i3_fetch_scratchpad_windows_in_order(Arena *arena, I3_Ipc *ipc, I3_Ipc_Request *requests, size_t count,
+                                             Json_Query *query) {
+    assert(count > 0 && requests[count - 1].type == I3_MSG_GET_TREE);
+    if (!i3_ipc_send_requests(ipc, requests, count)) {
+        fprintf(stderr, "Error: could not send message to i3: %s\n", ipc->error);
+        exit(1);
+    }
+
+    while (true) {
+        I3_Ipc_Header header = {0};
+        if (!i3_ipc_receive_header(ipc, &header)) {
+            fprintf(stderr, "Error: could not receive message: %s\n", ipc->error);
             exit(1);
         }
-    }
+        I3_Ipc_Request *request = i3_ipc_match_reply(requests, count, header.type);
+        if (request == NULL && !(header.type & I3_EVENT_MASK)) {
+            fprintf(stderr, "Error: unexpected message type %u from i3\n", header.type);
+            exit(1);
+        }
+        if (header.type == I3_MSG_GET_TREE) {
+            return i3_receive_scratchpad_windows(arena, ipc, header, query);
+        }
 
-    Windows windows = {0};
-    size_t chosen_window_index = {0};
-    {
+        String_View reply = {0};
+        if (!i3_ipc_receive_payload(ipc, &header, &reply)) {
+            fprintf(stderr, "Error: could not receive message: %s\n", ipc->error);
+            exit(1);
+        }
+        if (request == NULL) {
+            continue;
+        }
+        assert(request->type == I3_MSG_SUBSCRIBE);
         Json_Object json = {0};
-        Json_Result result = i3_receive_message(&arena, socket_fd, &json);
+        Json_Result result = json_parse(arena, &json, reply.data, reply.size);
         if (result.failed) {
             fprintf(stderr, "Json parser error at %zu: %s\n", result.error_loc, result.error);
             exit(1);
         }
+        bool *success = (json.kind == JSON_OBJ_DICT)
+            ? json_dict_get_boolean(&json.as.dict, JSON_OBJ_STR_FROM_CSTR_LIT("success"))
+            : NULL;
+        if (success == NULL || !(*success)) {
+            fprintf(stderr, "Error: i3 refused subscription to %.*s\n", (int)request->payload.size, request->payload.data);
+            exit(1);
+        }
+    }
+}
 
-        assert(json.kind == JSON_OBJ_DICT);
-        Json_Dict *dict = &json.as.dict;
+// NOTE(nic): the subscription and the first tree go out together, one round trip for both
+// and nothing can change in between without being seen
+Windows i3_subscribe_and_fetch_scratchpad_windows(Arena *arena, I3_Ipc *ipc, const char **events, size_t events_count,
+                                                  Json_Query *query) {
+    Json_Array event_names = {0};
+    for (size_t i = 0; i < events_count; ++i) {
+        arena_da_append(arena, &event_names, json_obj_string(arena, events[i]));
+    }
+    String payload = {0};
+    json_write_array(arena, &payload, &event_names, JSON_WRITE_COMPACT);
 
-        Json_Array *nodes = json_dict_get_array(dict, JSON_OBJ_STR_FROM_CSTR_LIT("nodes"));
-        if (nodes == NULL) {
-            fprintf(stderr, "Error: could not find i3 nodes\n");
-            exit(1);
+    I3_Ipc_Request requests[] = {
+        { .type = I3_MSG_SUBSCRIBE, .payload = { payload.items, payload.count } },
+        { .type = I3_MSG_GET_TREE },
+    };
+    return i3_fetch_scratchpad_windows_in_order(arena, ipc, requests, sizeof(requests)/sizeof(*requests), query);
+}
+
+typedef struct {
+    Arena arena;
+    Windows windows;
+    size_t garbage;
+} Scratchpad_Model;
+
+ssize_t scratchpad_model_find(Scratchpad_Model *model, int64_t id) {
+    for (size_t i = 0; i < model->windows.count; ++i) {
+        if (model->windows.items[i].id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+String_View scratchpad_model_copy_name(Scratchpad_Model *model, String_View name) {
+    char *data = arena_memdup(&model->arena, (void *)name.data, name.size);
+    return (String_View) { data, name.size };
+}
+
+void scratchpad_model_reset(Scratchpad_Model *model, Windows *windows) {
+    Arena arena = {0};
+    Windows copy = {0};
+    for (size_t i = 0; i < windows->count; ++i) {
+        Window window = windows->items[i];
+        window.name.data = arena_memdup(&arena, (void *)window.name.data, window.name.size);
+        arena_da_append(&arena, &copy, window);
+    }
+    // NOTE(nic): `windows` may point into the old model arena, so it is only freed after copying
+    arena_free(&model->arena);
+    model->arena = arena;
+    model->windows = copy;
+    model->garbage = 0;
+}
+
+void scratchpad_model_put(Scratchpad_Model *model, int64_t id, String_View name) {
+    ssize_t index = scratchpad_model_find(model, id);
+    if (index < 0) {
+        Window window = { id, scratchpad_model_copy_name(model, name) };
+        arena_da_append(&model->arena, &model->windows, window);
+        return;
+    }
+    Window *window = &model->windows.items[index];
+    if (sv_eq(window->name, name)) {
+        return;
+    }
+    model->garbage += window->name.size;
+    window->name = scratchpad_model_copy_name(model, name);
+}
+
+void scratchpad_model_remove(Scratchpad_Model *model, int64_t id) {
+    ssize_t index = scratchpad_model_find(model, id);
+    if (index < 0) {
+        return;
+    }
+    Windows *windows = &model->windows;
+    model->garbage += windows->items[index].name.size;
+    memmove(&windows->items[index], &windows->items[index + 1],
+            (windows->count - index - 1) * sizeof(*windows->items));
+    windows->count -= 1;
+}
+
+// NOTE(nic): window events carry the affected container, which is usually the window itself,
+// but may be a wrapper around it (e.g. the floating con a scratchpad window lives in)
+Windows i3_event_container_windows(Arena *arena, Json_Tape *tape, size_t container) {
+    I3_Node node = {0};
+    i3_decode_node(arena, tape, container, &node);
+    Window window = {0};
+    if (i3_node_window(&node, &window)) {
+        Windows windows = {0};
+        arena_da_append(arena, &windows, window);
+        return windows;
+    }
+    return i3_get_container_windows(arena, tape, container);
+}
+
+// NOTE(nic): returns false when the event can not be applied as a delta and the model needs a resync
+bool scratchpad_model_apply_event(Scratchpad_Model *model, Arena *arena, uint32_t type, String_View payload) {
+    Json_Tape tape = {0};
+    Json_Result result = json_tape_parse(arena, &tape, payload.data, payload.size);
+    if (result.failed || tape.items[0].kind != JSON_OBJ_DICT) {
+        return false;
+    }
+    size_t change = json_tape_dict_get(&tape, 0, SV("change"));
+    if (change == JSON_TAPE_NONE || tape.items[change].kind != JSON_OBJ_STRING) {
+        return false;
+    }
+
+    if (type == I3_EVENT_WORKSPACE) {
+        // NOTE(nic): a config reload may rebuild anything, every other workspace change leaves the scratchpad alone
+        return !json_tape_string_eq(&tape, change, SV("reload"));
+    }
+    if (type != I3_EVENT_WINDOW) {
+        return true;
+    }
+
+    size_t container = json_tape_dict_get(&tape, 0, SV("container"));
+    if (container == JSON_TAPE_NONE || tape.items[container].kind != JSON_OBJ_DICT) {
+        return false;
+    }
+    Windows windows = i3_event_container_windows(arena, &tape, container);
+
+    if (json_tape_string_eq(&tape, change, SV("close"))) {
+        for (size_t i = 0; i < windows.count; ++i) {
+            scratchpad_model_remove(model, windows.items[i].id);
+        }
+    } else if (json_tape_string_eq(&tape, change, SV("title"))) {
+        for (size_t i = 0; i < windows.count; ++i) {
+            if (scratchpad_model_find(model, windows.items[i].id) >= 0) {
+                scratchpad_model_put(model, windows.items[i].id, windows.items[i].name);
+            }
+        }
+    } else if (json_tape_string_eq(&tape, change, SV("move"))) {
+        for (size_t i = 0; i < windows.count; ++i) {
+            int64_t id = windows.items[i].id;
+            if (scratchpad_model_find(model, id) >= 0) {
+                // NOTE(nic): the only way out of the hidden scratchpad workspace is `scratchpad show`
+                scratchpad_model_remove(model, id);
+            } else {
+                // NOTE(nic): the payload does not say where the window ended up, and `scratchpad_state` stays
+                // `fresh`/`changed` for a scratchpad window that is shown and moved between workspaces,
+                // so only the tree can tell whether it went into the hidden workspace
+                return false;
+            }
+        }
+    }
+    // NOTE(nic): new, focus, floating, urgent, mark, ... do not change what is hidden in the scratchpad
+    return true;
+}
+
+void scratchpad_model_compact(Scratchpad_Model *model) {
+    if (model->garbage < MODEL_GARBAGE_LIMIT) {
+        return;
+    }
+    Windows windows = model->windows;
+    scratchpad_model_reset(model, &windows);
+}
+
+void run_daemon(Json_Query *scratchpad_query) {
+    // NOTE(nic): clients may hang up before we are done writing the list
+    signal(SIGPIPE, SIG_IGN);
+
+    Arena arena = {0};
+    const char *socket_path = daemon_socket_path(&arena);
+    int listen_fd = daemon_listen(socket_path);
+    printf("Daemon listening on: %s\n", socket_path);
+
+    // NOTE(nic): holds the serialized list and everything temporary, thrown away on every change
+    Arena temp_arena = {0};
+    String serialized = {0};
+
+    // NOTE(nic): everything goes over the one connection, so replies and events come in the order i3 sent them
+    I3_Ipc event_ipc = i3_connect();
+    const char *events[] = { "window", "workspace" };
+    Windows windows = i3_subscribe_and_fetch_scratchpad_windows(&temp_arena, &event_ipc, events, sizeof(events)/sizeof(*events),
+                                                                scratchpad_query);
+
+    Scratchpad_Model model = {0};
+    scratchpad_model_reset(&model, &windows);
+    bool needs_resync = false;
+
+    while (true) {
+        if (needs_resync) {
+            // NOTE(nic): the events still queued from before the tree are dropped on the way to it, and the ones
+            // after it are applied on top as usual
+            arena_reset(&temp_arena);
+            I3_Ipc_Request request = { .type = I3_MSG_GET_TREE };
+            Windows windows = i3_fetch_scratchpad_windows_in_order(&temp_arena, &event_ipc, &request, 1, scratchpad_query);
+            scratchpad_model_reset(&model, &windows);
+            needs_resync = false;
+            serialized = (String) {0};
+        }
+        if (serialized.count == 0) {
+            arena_reset(&temp_arena);
+            windows_serialize(&temp_arena, &serialized, &model.windows);
         }
 
-        Json_Dict *scratchpad = i3_find_scratchpad(nodes);
-        if (scratchpad == NULL) {
-            fprintf(stderr, "Error: could not find i3 scratchpad\n");
+        struct pollfd fds[2] = {
+            { .fd = listen_fd, .events = POLLIN },
+            { .fd = event_ipc.fd, .events = POLLIN },
+        };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Error: poll failed: %s\n", strerror(errno));
             exit(1);
         }
 
-        windows = i3_get_scratchpad_windows(&arena, scratchpad);
+        if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            // NOTE(nic): i3 sends events in bursts, apply all of them before serializing again
+            struct pollfd event_pollfd = { .fd = event_ipc.fd, .events = POLLIN };
+            do {
+                Arena_Mark mark = arena_snapshot(&arena);
+                I3_Ipc_Header header = {0};
+                String_View payload = {0};
+                if (!i3_ipc_receive(&event_ipc, &header, &payload)) {
+                    fprintf(stderr, "Error: could not receive event: %s\n", event_ipc.error);
+                    exit(1);
+                }
+                if (!needs_resync && !scratchpad_model_apply_event(&model, &arena, header.type, payload)) {
+                    needs_resync = true;
+                }
+                arena_rewind(&arena, mark);
+            } while (poll(&event_pollfd, 1, 0) > 0);
+
+            scratchpad_model_compact(&model);
+            serialized = (String) {0};
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int client_fd = accept(listen_fd, NULL, NULL);
+            if (client_fd < 0) {
+                continue;
+            }
+            // NOTE(nic): a second daemon checking whether we are alive hangs up without reading
+            if (!send_all(client_fd, serialized.items, serialized.count) && errno != EPIPE) {
+                fprintf(stderr, "Warning: could not send windows to client: %s\n", strerror(errno));
+            }
+            close(client_fd);
+        }
+    }
+}
+
+// NOTE(nic): returns false when no daemon is running, so the caller can fetch the tree itself
+bool daemon_fetch_windows(Arena *arena, Windows *windows) {
+    int daemon_fd = unix_connect(daemon_socket_path(arena));
+    if (daemon_fd < 0) {
+        return false;
+    }
+
+    struct timeval timeout = {
+        .tv_sec = DAEMON_RECEIVE_TIMEOUT_MS / 1000,
+        .tv_usec = (DAEMON_RECEIVE_TIMEOUT_MS % 1000) * 1000,
+    };
+    setsockopt(daemon_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    String data = {0};
+    if (!read_all(arena, daemon_fd, &data)) {
+        fprintf(stderr, "Warning: no reply from daemon: %s, falling back to i3\n", strerror(errno));
+        close(daemon_fd);
+        return false;
+    }
+    close(daemon_fd);
+
+    if (!windows_deserialize(arena, &data, windows)) {
+        fprintf(stderr, "Warning: invalid reply from daemon, falling back to i3\n");
+        *windows = (Windows) {0};
+        return false;
+    }
+    return true;
+}
+
+typedef struct {
+    size_t *items;
+    size_t count;
+    size_t capacity;
+} Selection;
+
+typedef struct {
+    int failed;
+    const char *error;
+    Selection selection; // NOTE(nic): indices into the windows in the order they were picked, empty if none were
+} Prompt_Result;
+
+String_View window_label(Arena *arena, size_t index, Window *window) {
+    String label = {0};
+    str_append_fmt(arena, &label, "%zu. ", index + 1);
+    str_append_sv(arena, &label, window->name);
+    return (String_View) { label.items, label.count };
+}
+
+bool selection_contains(Selection *selection, size_t index) {
+    for (size_t i = 0; i < selection->count; ++i) {
+        if (selection->items[i] == index) {
+            return true;
+        }
+    }
+    return false;
+}
+
+extern char **environ;
+
+static char *menu_argv[] = { "dmenu", "-i", "-p", "Window to bring back from the Shadow Realm", NULL };
+
+// NOTE(nic): dmenu runs straight from here with its stdin and stdout on pipes, there is no shell in between
+typedef struct {
+    pid_t pid;
+    int in;  // NOTE(nic): where the labels go
+    int out; // NOTE(nic): where the selection comes from
+} Menu;
+
+// NOTE(nic): returns NULL on success, what went wrong otherwise
+const char *menu_spawn(Menu *menu) {
+    printf("Executing the folowing command:\n");
+    for (size_t i = 0; menu_argv[i] != NULL; ++i) {
+        const char *format = (strchr(menu_argv[i], ' ') != NULL) ? "\"%s\"" : "%s";
+        if (i > 0) {
+            printf(" ");
+        }
+        printf(format, menu_argv[i]);
+    }
+    printf("\n");
+
+    int in[2] = {-1, -1};
+    int out[2] = {-1, -1};
+    if (pipe(in) < 0 || pipe(out) < 0) {
+        const char *error = strerror(errno);
+        for (size_t i = 0; i < 2; ++i) {
+            if (in[i] >= 0) close(in[i]);
+            if (out[i] >= 0) close(out[i]);
+        }
+        return error;
+    }
+    // NOTE(nic): none of these should outlive the dup2 in dmenu, nor leak into anything else we spawn
+    for (size_t i = 0; i < 2; ++i) {
+        fcntl(in[i], F_SETFD, FD_CLOEXEC);
+        fcntl(out[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+    // NOTE(nic): ignored signals stay ignored across exec, and the SIGPIPE we ignore is none of dmenu's business
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &default_signals);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+    int err = posix_spawnp(&menu->pid, menu_argv[0], &actions, &attr, menu_argv, environ);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+
+    close(in[0]);
+    close(out[1]);
+    if (err != 0) {
+        close(in[1]);
+        close(out[0]);
+        return strerror(err);
+    }
+    menu->in = in[1];
+    menu->out = out[0];
+    return NULL;
+}
+
+// NOTE(nic): each label and its newline go out as iovecs straight from where they live, nothing is copied
+bool menu_write_labels(Arena *arena, Menu *menu, String_View *labels, size_t count) {
+    static char newline[] = "\n";
+    struct iovec *iov = arena_alloc(arena, 2*count*sizeof(*iov));
+    for (size_t i = 0; i < count; ++i) {
+        iov[2*i] = (struct iovec) { .iov_base = (void *)labels[i].data, .iov_len = labels[i].size };
+        iov[2*i + 1] = (struct iovec) { .iov_base = newline, .iov_len = 1 };
+    }
+    return write_iov(menu->in, iov, 2*count);
+}
+
+void menu_wait(Menu *menu) {
+    while (waitpid(menu->pid, NULL, 0) < 0 && errno == EINTR);
+}
+
+// NOTE(nic): killed before its stdin is closed, dmenu never gets to show itself
+void menu_cancel(Menu *menu) {
+    kill(menu->pid, SIGTERM);
+    close(menu->in);
+    close(menu->out);
+    menu_wait(menu);
+}
+
+// NOTE(nic): the menu is started before we know whether there is anything to show. Until it has its labels
+// any way out of the program has to take it down too, or it would pop up empty when its stdin closes.
+static Menu *pending_menu = NULL;
+
+void menu_cancel_pending(void) {
+    if (pending_menu != NULL) {
+        menu_cancel(pending_menu);
+        pending_menu = NULL;
+    }
+}
+
+// NOTE(nic): with `multi` every line dmenu prints counts (Ctrl-Return picks an item and keeps dmenu open),
+// otherwise only the first one does. The menu is spawned already and SIGPIPE ignored, the user closing it
+// before it has read every label is not an error.
+Prompt_Result prompt_user(Arena *arena, Menu *menu, Windows *windows, bool multi) {
+    Prompt_Result result = {0};
+
+    String_View *labels = arena_alloc(arena, windows->count * sizeof(*labels));
+    for (size_t i = 0; i < windows->count; ++i) {
+        labels[i] = window_label(arena, i, &windows->items[i]);
+    }
+
+    if (!menu_write_labels(arena, menu, labels, windows->count) && errno != EPIPE) {
+        result.failed = true;
+        result.error = strerror(errno);
+    }
+    close(menu->in);
+    pending_menu = NULL;
+
+    String output = {0};
+    if (!read_all(arena, menu->out, &output) && !result.failed) {
+        result.failed = true;
+        result.error = strerror(errno);
+    }
+    close(menu->out);
+    menu_wait(menu);
+    if (result.failed) {
+        return result;
+    }
+
+    // NOTE(nic): user closed dmenu without selecting a window when there is no output at all
+    String_View rest = { output.items, output.count };
+    while (rest.size > 0) {
+        size_t end = rest.size;
+        sv_find(rest, '\n', &end);
+        String_View line = { rest.data, end };
+        rest.data += (end < rest.size) ? end + 1 : end;
+        rest.size -= (end < rest.size) ? end + 1 : end;
+
+        for (size_t i = 0; i < windows->count; ++i) {
+            // NOTE(nic): `scratchpad show` on a window that is already out hides it again, so no repeats
+            if (sv_eq(labels[i], line) && !selection_contains(&result.selection, i)) {
+                arena_da_append(arena, &result.selection, i);
+                break;
+            }
+        }
+
+        if (!multi) {
+            break;
+        }
+    }
+
+    return result;
+}
+
+void show_notification(Arena *arena, const char *message) {
+    String cmd = {0};
+    str_append_fmt(arena, &cmd, "dunstify 'dmenu_scratchpad' '%s' -t 2000", message);
+    str_append_null(arena, &cmd);
+    // NOTE(nic): we don't particularly care if this fails. The shell would inherit an ignored SIGPIPE,
+    // so it gets the default one for as long as it runs.
+    void (*sigpipe_handler)(int) = signal(SIGPIPE, SIG_DFL);
+    system(cmd.items);
+    signal(SIGPIPE, sigpipe_handler);
+}
+
+// NOTE(nic): one `scratchpad show` per window chained with `;`, so they all go to i3 in a single message
+String scratchpad_show_command(Arena *arena, Windows *windows, Selection *selection) {
+    String command = {0};
+    for (size_t i = 0; i < selection->count; ++i) {
+        if (i > 0) {
+            str_append_cstr(arena, &command, "; ");
+        }
+        Window *window = &windows->items[selection->items[i]];
+        str_append_fmt(arena, &command, "[con_id=\"%zu\"] scratchpad show", window->id);
+    }
+    str_append_null(arena, &command);
+    return command;
+}
+
+// NOTE(nic): i3 answers a RUN_COMMAND with one of these per command, reports it and returns its `success`
+bool i3_check_command_result(Arena *arena, Json_Dict *dict) {
+    bool *success = json_dict_get_boolean(dict, JSON_OBJ_STR_FROM_CSTR_LIT("success"));
+    if (success == NULL) {
+        fprintf(stderr, "Error: could not find `success` entry in i3 response\n");
+        exit(1);
+    }
+
+    if (!(*success)) {
+        String *error = json_dict_get_decoded_string(arena, dict, JSON_OBJ_STR_FROM_CSTR_LIT("error"));
+        bool *parse_error = json_dict_get_boolean(dict, JSON_OBJ_STR_FROM_CSTR_LIT("parse_error"));
+        if (parse_error != NULL && *parse_error) {
+            String *input = json_dict_get_decoded_string(arena, dict, JSON_OBJ_STR_FROM_CSTR_LIT("input"));
+            String *pos = json_dict_get_decoded_string(arena, dict, JSON_OBJ_STR_FROM_CSTR_LIT("errorposition"));
+            fprintf(
+                stderr, "Error: i3 could not parse command: %.*s\n",
+                (int)error->count, error->items
+            );
+            fprintf(
+                stderr, "Input: %.*s\n       %.*s\n",
+                (int)input->count, input->items,
+                (int)pos->count, pos->items
+            );
+        } else {
+            fprintf(
+                stderr, "Error: i3 could not execute command: %.*s\n",
+                (int)error->count, error->items
+            );
+        }
+    }
+    return *success;
+}
+
+void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--daemon | --multi]\n", program);
+    fprintf(stderr, "    --daemon    keep the scratchpad list in memory and serve it to other invocations\n");
+    fprintf(stderr, "    --multi     bring back every window picked with Ctrl-Return, not just the first one\n");
+}
+
+int main(int argc, char **argv) {
+    i3_key_slots_init();
+    Arena query_arena = {0};
+    Json_Query scratchpad_query = i3_scratchpad_query_compile(&query_arena);
+
+    bool multi = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--daemon") == 0) {
+            run_daemon(&scratchpad_query);
+            return 0;
+        }
+        if (strcmp(argv[i], "--multi") == 0) {
+            multi = true;
+            continue;
+        }
+        usage(argv[0]);
+        exit(1);
+    }
+
+    Arena arena = {0};
+    I3_Ipc ipc = i3_ipc_from_fd(-1);
+
+    Windows windows = {0};
+    Selection selection = {0};
+    {
+        // NOTE(nic): dmenu takes about as long to come up as we take to find the windows,
+        // so it starts first and waits on its stdin while we do
+        signal(SIGPIPE, SIG_IGN);
+        Menu menu = {0};
+        const char *menu_error = menu_spawn(&menu);
+        if (menu_error == NULL) {
+            pending_menu = &menu;
+            atexit(menu_cancel_pending);
+        }
+
+        if (!daemon_fetch_windows(&arena, &windows)) {
+            ipc = i3_connect();
+            windows = i3_fetch_scratchpad_windows(&arena, &ipc, &scratchpad_query);
+        }
+
         if (windows.count <= 0) {
+            menu_cancel_pending();
             show_notification(&arena, "Scratchpad is empty");
             exit(0);
         }
 
-        Prompt_Result prompt_result = prompt_user(&arena, &windows);
+        if (menu_error != NULL) {
+            fprintf(stderr, "Error: dmenu call failed: %s\n", menu_error);
+            exit(1);
+        }
+
+        Prompt_Result prompt_result = prompt_user(&arena, &menu, &windows, multi);
         if (prompt_result.failed) {
             fprintf(stderr, "Error: dmenu call failed: %s\n", prompt_result.error);
             exit(1);
         }
-        if (prompt_result.index < 0) {
+        if (prompt_result.selection.count <= 0) {
             // NOTE(nic): user closed dmenu without selecting any window
             exit(0);
         }
-        chosen_window_index = (size_t) prompt_result.index;
+        selection = prompt_result.selection;
     }
 
-    {
-        Window chosen_window = windows.items[chosen_window_index];
-        String command = {0};
-        str_append_fmt(&arena, &command, "[con_id=\"%zu\"] scratchpad show", chosen_window.id);
-        str_append_null(&arena, &command);
+    if (ipc.fd < 0) {
+        ipc = i3_connect();
+    }
 
-        String packet = {0};
-        str_append_cstr(&arena, &packet, I3_MAGIC);
-        str_append_uint32_bytes_le(&arena, &packet, (uint32_t)command.count - 1);
-        str_append_uint32_bytes_le(&arena, &packet, 0);
-        str_append_cstr(&arena, &packet, command.items);
+    {
+        String command = scratchpad_show_command(&arena, &windows, &selection);
 
         printf("Sending following message:\n");
         printf("%s\n", command.items);
 
-        ssize_t bytes_sent = send(socket_fd, packet.items, packet.count, 0);
-        if (bytes_sent < 0) {
-            fprintf(stderr, "Error: could not send message to i3: %s\n", strerror(errno));
-            exit(1);
-        }
+        i3_send_message(&ipc, I3_MSG_RUN_COMMAND, (String_View) { command.items, command.count - 1 });
     }
 
     {
         Json_Object json = {0};
-        Json_Result result = i3_receive_message(&arena, socket_fd, &json);
+        Json_Result result = i3_receive_message(&arena, &ipc, I3_MSG_RUN_COMMAND, &json);
         if (result.failed) {
             fprintf(stderr, "Json parser error at %zu: %s\n", result.error_loc, result.error);
             exit(1);
@@ -355,39 +1345,31 @@ int main(void) {
 
         assert(json.kind == JSON_OBJ_ARRAY);
         Json_Array *array = &json.as.array;
-
-        Json_Dict *dict = json_array_get_dict(array, 0);
-        bool *success = json_dict_get_boolean(dict, JSON_OBJ_STR_FROM_CSTR_LIT("success"));
-        if (success == NULL) {
-            fprintf(stderr, "Error: could not find `success` entry in i3 response\n");
+        for (size_t i = 0; i < array->count; ++i) {
+            if (array->items[i].kind != JSON_OBJ_DICT) {
+                fprintf(stderr, "Error: unexpected i3 response\n");
+                exit(1);
+            }
+        }
+        // NOTE(nic): when the command list does not parse, i3 answers with a single result for all of it
+        if (array->count == 1 && selection.count > 1 && !i3_check_command_result(&arena, &array->items[0].as.dict)) {
+            exit(1);
+        }
+        if (array->count != selection.count) {
+            fprintf(stderr, "Error: sent %zu commands to i3 but got %zu results\n", selection.count, array->count);
             exit(1);
         }
 
-        if (!(*success)) {
-            String *error = json_dict_get_string(dict, JSON_OBJ_STR_FROM_CSTR_LIT("error"));
-            bool *parse_error = json_dict_get_boolean(dict, JSON_OBJ_STR_FROM_CSTR_LIT("parse_error"));
-            if (parse_error != NULL && *parse_error) {
-                String *input = json_dict_get_string(dict, JSON_OBJ_STR_FROM_CSTR_LIT("input"));
-                String *pos = json_dict_get_string(dict, JSON_OBJ_STR_FROM_CSTR_LIT("errorposition"));
-                fprintf(
-                    stderr, "Error: i3 could not parse command: %.*s\n",
-                    (int)error->count, error->items
-                );
-                fprintf(
-                    stderr, "Input: %.*s\n       %.*s\n",
-                    (int)input->count, input->items,
-                    (int)pos->count, pos->items
-                );
-            } else {
-                fprintf(
-                    stderr, "Error: i3 could not execute command: %.*s\n",
-                    (int)error->count, error->items
-                );
+        for (size_t i = 0; i < array->count; ++i) {
+            if (!i3_check_command_result(&arena, &array->items[i].as.dict) && array->count > 1) {
+                Window *window = &windows.items[selection.items[i]];
+                fprintf(stderr, "Window: %.*s\n", (int)window->name.size, window->name.data);
             }
         }
     }
 
     arena_free(&arena);
-    close(socket_fd);
+    arena_free(&query_arena);
+    i3_ipc_close(&ipc);
     return 0;
 }
@@ -10,6 +10,16 @@ String str_with_cap(Arena *arena, size_t cap) {
     return str;
 }
 
+void str_own(Arena *arena, String *str) {
+    if (str->count <= str->capacity) {
+        return;
+    }
+    String owned = str_with_cap(arena, str->count);
+    memcpy(owned.items, str->items, str->count);
+    owned.count = str->count;
+    *str = owned;
+}
+
 bool str_eq(String *a, String *b) {
     if (a->count != b->count) {
         return false;
@@ -32,6 +42,7 @@ void str_append_vfmt(Arena *arena, String *str, const char *fmt, va_list args) {
     va_end(copy);
     char temp[(str_size + 1) * sizeof(char)];
     vsnprintf(temp, str_size + 1, fmt, args);
+    str_own(arena, str);
     arena_da_append_many(arena, str, temp, str_size);
 }
 
@@ -42,18 +53,170 @@ void str_append_fmt(Arena *arena, String *str, const char *fmt, ...) {
     va_end(args);
 }
 
+// NOTE(nic): accepts an optional minus followed by digits only, fails instead of overflowing
+bool sv_parse_int64(String_View sv, int64_t *n) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < sv.size && sv.data[i] == '-') {
+        negative = true;
+        i += 1;
+    }
+    if (i >= sv.size) {
+        return false;
+    }
+
+    uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    uint64_t value = 0;
+    for (; i < sv.size; ++i) {
+        char ch = sv.data[i];
+        if (ch < '0' || ch > '9') {
+            return false;
+        }
+        uint64_t digit = ch - '0';
+        if (value > (limit - digit) / 10) {
+            return false;
+        }
+        value = value*10 + digit;
+    }
+
+    if (!negative) {
+        *n = (int64_t)value;
+    } else if (value == (uint64_t)INT64_MAX + 1) {
+        *n = INT64_MIN;
+    } else {
+        *n = -(int64_t)value;
+    }
+    return true;
+}
+
+// NOTE(nic): powers of ten that are exactly representable as doubles
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+#define DECIMAL_MAX_EXACT_MANTISSA (1ull << 53)
+#define DECIMAL_MAX_EXACT_EXPONENT 22
+#define DECIMAL_STACK_BUFFER_SIZE 64
+
+// NOTE(nic): accepts `-?digits(.digits)?([eE][+-]?digits)?`. Whenever both the digits and the power
+// of ten fit a double exactly, a single multiplication or division is correctly rounded (Clinger's
+// fast path), which covers everything i3 sends. Anything else goes through strtod.
+bool sv_parse_decimal(String_View sv, double *n) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < sv.size && sv.data[i] == '-') {
+        negative = true;
+        i += 1;
+    }
+
+    uint64_t mantissa = 0;
+    size_t digits = 0;
+    bool exact = true;
+    int64_t exponent = 0;
+
+    size_t integer_digits = 0;
+    for (; i < sv.size && sv.data[i] >= '0' && sv.data[i] <= '9'; ++i) {
+        if (digits < 19) {
+            mantissa = mantissa*10 + (sv.data[i] - '0');
+            digits += (mantissa != 0);
+        } else {
+            exact = false;
+        }
+        integer_digits += 1;
+    }
+    if (integer_digits == 0) {
+        return false;
+    }
+    if (!exact) {
+        exponent += integer_digits - digits;
+    }
+
+    if (i < sv.size && sv.data[i] == '.') {
+        i += 1;
+        size_t fraction_digits = 0;
+        for (; i < sv.size && sv.data[i] >= '0' && sv.data[i] <= '9'; ++i) {
+            if (digits < 19) {
+                mantissa = mantissa*10 + (sv.data[i] - '0');
+                digits += (mantissa != 0);
+                exponent -= 1;
+            } else {
+                exact = false;
+            }
+            fraction_digits += 1;
+        }
+        if (fraction_digits == 0) {
+            return false;
+        }
+    }
+
+    if (i < sv.size && (sv.data[i] == 'e' || sv.data[i] == 'E')) {
+        i += 1;
+        bool exponent_negative = false;
+        if (i < sv.size && (sv.data[i] == '+' || sv.data[i] == '-')) {
+            exponent_negative = sv.data[i] == '-';
+            i += 1;
+        }
+        int64_t explicit_exponent = 0;
+        size_t exponent_digits = 0;
+        for (; i < sv.size && sv.data[i] >= '0' && sv.data[i] <= '9'; ++i) {
+            // NOTE(nic): anything past this saturates to zero or infinity anyway
+            if (explicit_exponent < 100000) {
+                explicit_exponent = explicit_exponent*10 + (sv.data[i] - '0');
+            }
+            exponent_digits += 1;
+        }
+        if (exponent_digits == 0) {
+            return false;
+        }
+        exponent += exponent_negative ? -explicit_exponent : explicit_exponent;
+    }
+
+    if (i != sv.size) {
+        return false;
+    }
+
+    if (exact && mantissa <= DECIMAL_MAX_EXACT_MANTISSA &&
+        exponent >= -DECIMAL_MAX_EXACT_EXPONENT && exponent <= DECIMAL_MAX_EXACT_EXPONENT)
+    {
+        double value = (double)mantissa;
+        if (exponent < 0) {
+            value /= exact_powers_of_ten[-exponent];
+        } else {
+            value *= exact_powers_of_ten[exponent];
+        }
+        *n = negative ? -value : value;
+        return true;
+    }
+
+    char stack_buffer[DECIMAL_STACK_BUFFER_SIZE];
+    char *buffer = stack_buffer;
+    if (sv.size + 1 > sizeof(stack_buffer)) {
+        buffer = malloc(sv.size + 1);
+        if (buffer == NULL) {
+            return false;
+        }
+    }
+    memcpy(buffer, sv.data, sv.size);
+    buffer[sv.size] = '\0';
+    *n = strtod(buffer, NULL);
+    if (buffer != stack_buffer) {
+        free(buffer);
+    }
+    return true;
+}
+
+// NOTE(nic): for text that was already validated by the lexer
 int64_t sv_to_int64(String_View sv) {
-    char int64_string[sv.size + 1];
-    memcpy(int64_string, sv.data, sv.size);
-    int64_string[sv.size] = '\0';
-    return atoll(int64_string);
+    int64_t n = 0;
+    (void)sv_parse_int64(sv, &n);
+    return n;
 }
 
 double sv_to_decimal(String_View sv) {
-    char decimal_string[sv.size + 1];
-    memcpy(decimal_string, sv.data, sv.size);
-    decimal_string[sv.size] = '\0';
-    return strtod(decimal_string, NULL);
+    double n = 0.0;
+    (void)sv_parse_decimal(sv, &n);
+    return n;
 }
 
 bool sv_find(String_View sv, char ch, size_t *index) {
@@ -84,5 +247,6 @@ bool sv_eq(String_View a, String_View b) {
     if (a.size != b.size) {
         return false;
     }
-    return memcmp(a.data, b.data, a.size) == 0;
+    // NOTE(nic): zeroed views have no data, and memcmp wants a pointer even for zero bytes
+    return a.size == 0 || memcmp(a.data, b.data, a.size) == 0;
 }
@@ -10,11 +10,16 @@
 
 #define SV(cstr) ((String_View) { .data = (cstr), .size = strlen(cstr) })
 #define SV_STATIC(cstr) { .data = (cstr), .size = sizeof(cstr) - 1 }
+#define SV_EMPTY ((String_View) { .data = "", .size = 0 })
 
-#define str_append_char(a, str, ch) arena_da_append((a), (str), ch)
-#define str_append_sv(a, str, sv) arena_da_append_many((a), (str), (sv).data, (sv).size)
-#define str_append_cstr(a, str, cstr) arena_da_append_many((a), (str), (cstr), strlen(cstr))
-#define str_append_null(a, str) arena_da_append((a), (str), '\0')
+#define str_append_char(a, str, ch) \
+    do { str_own((a), (str)); arena_da_append((a), (str), ch); } while (0)
+#define str_append_sv(a, str, sv) \
+    do { str_own((a), (str)); arena_da_append_many((a), (str), (sv).data, (sv).size); } while (0)
+#define str_append_cstr(a, str, cstr) \
+    do { str_own((a), (str)); arena_da_append_many((a), (str), (cstr), strlen(cstr)); } while (0)
+#define str_append_null(a, str) \
+    do { str_own((a), (str)); arena_da_append((a), (str), '\0'); } while (0)
 
 typedef struct {
     char *items;
@@ -23,6 +28,9 @@ typedef struct {
 } String;
 
 String str_with_cap(Arena *arena, size_t cap);
+// NOTE(nic): a String with more bytes than capacity borrows them from somewhere else (parsed strings do),
+// they get copied into the arena so they can be appended to
+void str_own(Arena *arena, String *str);
 bool str_eq(String *a, String *b);
 bool str_eq_cstr(String *a, const char *b);
 void str_append_vfmt(Arena *arena, String *str, const char *fmt, va_list args);
@@ -33,6 +41,8 @@ typedef struct {
     size_t size;
 } String_View;
 
+bool sv_parse_int64(String_View sv, int64_t *n);
+bool sv_parse_decimal(String_View sv, double *n);
 int64_t sv_to_int64(String_View sv);
 double sv_to_decimal(String_View sv);
 
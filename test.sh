@@ -0,0 +1,12 @@
+#!/usr/bin/sh
+set -xe
+
+CFLAGS="-Wall -Wextra -pedantic -ggdb -std=c99"
+mkdir -p build
+gcc $CFLAGS -pthread -o build/json_test test/json_test.c src/json.c src/json_tape.c src/utils.c
+./build/json_test
+gcc $CFLAGS -o build/i3_ipc_test test/i3_ipc_test.c src/i3_ipc.c src/utils.c
+./build/i3_ipc_test
+gcc $CFLAGS -pthread -o build/dmenu_scratch src/main.c src/json.c src/json_tape.c src/json_query.c src/i3_ipc.c src/utils.c
+gcc $CFLAGS -o build/daemon_test test/daemon_test.c src/i3_ipc.c src/utils.c
+./build/daemon_test ./build/dmenu_scratch
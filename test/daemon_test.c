@@ -0,0 +1,272 @@
+// NOTE(nic): for mkdtemp, kill and clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "../src/i3_ipc.h"
+#include "../src/utils.h"
+
+#define ARENA_IMPLEMENTATION
+#include "../src/arena.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                          \
+    do {                                                          \
+        if (!(cond)) {                                            \
+            fprintf(stderr, "%s:%d: FAIL: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__);                         \
+            fprintf(stderr, "\n");                                \
+            failures += 1;                                        \
+        }                                                         \
+    } while (0)
+
+#define TEST_TIMEOUT_MS 5000
+#define MAX_CLIENTS 4
+
+// NOTE(nic): X is in the scratchpad from the start, Y is moved there later
+#define WINDOW_X 101
+#define WINDOW_Y 102
+
+double now_ms(void) {
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+int unix_listen(const char *path) {
+    struct sockaddr_un sockaddr = { .sun_family = AF_UNIX };
+    strcpy(sockaddr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&sockaddr, sizeof(sockaddr)) < 0 || listen(fd, 8) < 0) {
+        perror("fake i3 socket");
+        exit(1);
+    }
+    return fd;
+}
+
+void append_window(Arena *arena, String *out, int64_t id, const char *name) {
+    str_append_fmt(arena, out,
+                   "{\"id\":%lld,\"type\":\"con\",\"name\":\"%s\",\"nodes\":[],\"floating_nodes\":[],"
+                   "\"window_properties\":{\"class\":\"%s\",\"title\":\"%s\"}}",
+                   (long long)id, name, name, name);
+}
+
+String tree_with(Arena *arena, bool with_y) {
+    String tree = {0};
+    str_append_cstr(arena, &tree,
+                    "{\"id\":1,\"type\":\"root\",\"name\":\"root\",\"nodes\":[{\"id\":2,\"type\":\"output\",\"name\":\"__i3\","
+                    "\"nodes\":[{\"id\":3,\"type\":\"con\",\"name\":\"content\",\"nodes\":[{\"id\":4,\"type\":\"workspace\","
+                    "\"name\":\"__i3_scratch\",\"nodes\":[],\"floating_nodes\":[");
+    append_window(arena, &tree, WINDOW_X, "X");
+    if (with_y) {
+        str_append_cstr(arena, &tree, ",");
+        append_window(arena, &tree, WINDOW_Y, "Y");
+    }
+    str_append_cstr(arena, &tree, "]}]}]}]}");
+    return tree;
+}
+
+String window_event(Arena *arena, const char *change, int64_t id, const char *name) {
+    String event = {0};
+    str_append_fmt(arena, &event, "{\"change\":\"%s\",\"container\":", change);
+    append_window(arena, &event, id, name);
+    str_append_cstr(arena, &event, "}");
+    return event;
+}
+
+void send_or_die(I3_Ipc *ipc, uint32_t type, String payload) {
+    if (!i3_ipc_send(ipc, type, (String_View) { payload.items, payload.count })) {
+        fprintf(stderr, "Error: fake i3 could not send: %s\n", ipc->error);
+        exit(1);
+    }
+}
+
+typedef struct {
+    int64_t ids[8];
+    char names[8][32];
+    size_t count;
+} Listed;
+
+// NOTE(nic): what a client gets from the daemon, false if it did not answer in time
+bool daemon_list(const char *path, Listed *listed) {
+    struct sockaddr_un sockaddr = { .sun_family = AF_UNIX };
+    strcpy(sockaddr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&sockaddr, sizeof(sockaddr)) < 0) {
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = 200*1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    uint8_t data[1024];
+    size_t size = 0;
+    while (size < sizeof(data)) {
+        ssize_t n = read(fd, data + size, sizeof(data) - size);
+        if (n <= 0) {
+            break;
+        }
+        size += (size_t)n;
+    }
+    close(fd);
+
+    // NOTE(nic): u32 count, then u64 id, u32 name size and the name per window, all little endian
+    size_t cursor = 0;
+    uint32_t count = 0;
+    if (size < 4) {
+        return false;
+    }
+    for (size_t i = 0; i < 4; ++i) count |= (uint32_t)data[cursor++] << (8*i);
+    listed->count = 0;
+    for (uint32_t w = 0; w < count && listed->count < 8; ++w) {
+        if (cursor + 12 > size) {
+            return false;
+        }
+        uint64_t id = 0;
+        uint32_t name_size = 0;
+        for (size_t i = 0; i < 8; ++i) id |= (uint64_t)data[cursor++] << (8*i);
+        for (size_t i = 0; i < 4; ++i) name_size |= (uint32_t)data[cursor++] << (8*i);
+        if (cursor + name_size > size || name_size >= sizeof(listed->names[0])) {
+            return false;
+        }
+        listed->ids[listed->count] = (int64_t)id;
+        memcpy(listed->names[listed->count], data + cursor, name_size);
+        listed->names[listed->count][name_size] = '\0';
+        listed->count += 1;
+        cursor += name_size;
+    }
+    return true;
+}
+
+// NOTE(nic): a move of Y makes the daemon resync. While i3 is answering, Y is moved again (say it was shown and
+// hidden right away), and that event goes out before the tree that already has Y hidden. After the tree X gets
+// renamed. Only the rename may be applied on top of the tree, applying the stale move would drop Y.
+void test_events_around_resync(const char *program) {
+    char dir[] = "/tmp/dmenu_scratch_test.XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    Arena arena = {0};
+    const char *i3_path = arena_sprintf(&arena, "%s/i3.sock", dir);
+    const char *daemon_path = arena_sprintf(&arena, "%s/daemon.sock", dir);
+    int listen_fd = unix_listen(i3_path);
+
+    pid_t daemon = fork();
+    if (daemon < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (daemon == 0) {
+        setenv("I3SOCK", i3_path, 1);
+        setenv("DMENU_SCRATCH_SOCK", daemon_path, 1);
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        execl(program, program, "--daemon", (char *)NULL);
+        perror("exec");
+        _exit(127);
+    }
+
+    I3_Ipc clients[MAX_CLIENTS];
+    size_t clients_count = 0;
+    int subscriber = -1;
+    size_t trees_sent = 0;
+    Listed listed = {0};
+    bool renamed = false;
+
+    double deadline = now_ms() + TEST_TIMEOUT_MS;
+    while (!renamed && now_ms() < deadline) {
+        struct pollfd fds[1 + MAX_CLIENTS] = {0};
+        fds[0] = (struct pollfd) { .fd = listen_fd, .events = POLLIN };
+        for (size_t i = 0; i < clients_count; ++i) {
+            fds[1 + i] = (struct pollfd) { .fd = clients[i].fd, .events = POLLIN };
+        }
+        poll(fds, 1 + clients_count, 20);
+
+        if ((fds[0].revents & POLLIN) && clients_count < MAX_CLIENTS) {
+            clients[clients_count++] = i3_ipc_from_fd(accept(listen_fd, NULL, NULL));
+        }
+        for (size_t i = 0; i < clients_count; ++i) {
+            if (!(fds[1 + i].revents & (POLLIN | POLLHUP))) {
+                continue;
+            }
+            I3_Ipc_Header header = {0};
+            String_View payload = {0};
+            if (!i3_ipc_receive(&clients[i], &header, &payload)) {
+                continue;
+            }
+            if (header.type == I3_MSG_SUBSCRIBE) {
+                subscriber = (int)i;
+                send_or_die(&clients[i], I3_MSG_SUBSCRIBE, (String) { "{\"success\":true}", 16, 0 });
+            } else if (header.type == I3_MSG_GET_TREE) {
+                CHECK(subscriber >= 0, "the tree was asked for before subscribing");
+                if (subscriber < 0) {
+                    break;
+                }
+                I3_Ipc *events = &clients[subscriber];
+                if (trees_sent == 0) {
+                    send_or_die(&clients[i], I3_MSG_GET_TREE, tree_with(&arena, false));
+                    send_or_die(events, I3_EVENT_WINDOW, window_event(&arena, "move", WINDOW_Y, "Y"));
+                } else if (trees_sent == 1) {
+                    send_or_die(events, I3_EVENT_WINDOW, window_event(&arena, "move", WINDOW_Y, "Y"));
+                    send_or_die(&clients[i], I3_MSG_GET_TREE, tree_with(&arena, true));
+                    send_or_die(events, I3_EVENT_WINDOW, window_event(&arena, "title", WINDOW_X, "renamed"));
+                } else {
+                    send_or_die(&clients[i], I3_MSG_GET_TREE, tree_with(&arena, true));
+                }
+                trees_sent += 1;
+            }
+        }
+
+        // NOTE(nic): the rename comes last on the event socket, once it shows every event before it was handled
+        if (trees_sent >= 2 && daemon_list(daemon_path, &listed)) {
+            for (size_t i = 0; i < listed.count; ++i) {
+                renamed = renamed || strcmp(listed.names[i], "renamed") == 0;
+            }
+        }
+    }
+
+    CHECK(trees_sent == 2, "expected one tree at startup and one resync, sent %zu trees", trees_sent);
+    CHECK(renamed, "the rename after the resync never showed up");
+    CHECK(listed.count == 2 && listed.ids[0] == WINDOW_X && listed.ids[1] == WINDOW_Y,
+          "expected X and Y in the scratchpad, the daemon lists %zu window(s)", listed.count);
+
+    kill(daemon, SIGTERM);
+    waitpid(daemon, NULL, 0);
+    for (size_t i = 0; i < clients_count; ++i) {
+        i3_ipc_close(&clients[i]);
+    }
+    close(listen_fd);
+    unlink(i3_path);
+    unlink(daemon_path);
+    rmdir(dir);
+    arena_free(&arena);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <path to dmenu_scratch>\n", argv[0]);
+        return 1;
+    }
+    test_events_around_resync(argv[1]);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("daemon_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,152 @@
+// NOTE(nic): for socketpair
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "../src/i3_ipc.h"
+#include "../src/utils.h"
+
+#define ARENA_IMPLEMENTATION
+#include "../src/arena.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                          \
+    do {                                                          \
+        if (!(cond)) {                                            \
+            fprintf(stderr, "%s:%d: FAIL: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__);                         \
+            fprintf(stderr, "\n");                                \
+            failures += 1;                                        \
+        }                                                         \
+    } while (0)
+
+// NOTE(nic): the framing is the same both ways, so the other end of the pair reads what was sent as i3 would
+void socket_pair(I3_Ipc *a, I3_Ipc *b) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        perror("socketpair");
+        exit(1);
+    }
+    *a = i3_ipc_from_fd(fds[0]);
+    *b = i3_ipc_from_fd(fds[1]);
+}
+
+void test_send_requests(Arena *arena) {
+    I3_Ipc client = {0};
+    I3_Ipc server = {0};
+    socket_pair(&client, &server);
+
+    // NOTE(nic): more than one batch, with empty payloads mixed in since those go out without an iovec of their own
+    I3_Ipc_Request requests[2*I3_IPC_SEND_BATCH + 3] = {0};
+    size_t count = sizeof(requests)/sizeof(*requests);
+    for (size_t i = 0; i < count; ++i) {
+        requests[i].type = (uint32_t)i;
+        if (i % 3 != 0) {
+            const char *payload = arena_sprintf(arena, "[\"request %zu\"]", i);
+            requests[i].payload = SV(payload);
+        }
+        requests[i].received = true;
+    }
+    CHECK(i3_ipc_send_requests(&client, requests, count), "send failed: %s", client.error);
+
+    for (size_t i = 0; i < count; ++i) {
+        CHECK(!requests[i].received, "request %zu still marked as received after sending", i);
+
+        I3_Ipc_Header header = {0};
+        String_View payload = {0};
+        if (!i3_ipc_receive(&server, &header, &payload)) {
+            CHECK(false, "receive of request %zu failed: %s", i, server.error);
+            break;
+        }
+        CHECK(header.type == i, "request %zu came with type %u", i, header.type);
+        CHECK(sv_eq(payload, requests[i].payload), "request %zu came with payload `%.*s`",
+              i, (int)payload.size, payload.data);
+    }
+
+    i3_ipc_close(&client);
+    i3_ipc_close(&server);
+}
+
+void test_match_reply(void) {
+    I3_Ipc_Request requests[] = {
+        { .type = I3_MSG_SUBSCRIBE },
+        { .type = I3_MSG_GET_TREE },
+        { .type = I3_MSG_GET_TREE },
+    };
+    size_t count = sizeof(requests)/sizeof(*requests);
+
+    // NOTE(nic): out of order, with events in between
+    CHECK(i3_ipc_match_reply(requests, count, I3_MSG_GET_TREE) == &requests[1], "first GET_TREE reply");
+    CHECK(i3_ipc_match_reply(requests, count, I3_EVENT_WINDOW) == NULL, "event matched a request");
+    CHECK(i3_ipc_match_reply(requests, count, I3_MSG_GET_TREE) == &requests[2], "second GET_TREE reply");
+    CHECK(i3_ipc_match_reply(requests, count, I3_MSG_GET_TREE) == NULL, "third GET_TREE reply matched");
+    CHECK(i3_ipc_match_reply(requests, count, I3_MSG_RUN_COMMAND) == NULL, "reply to nothing matched");
+    CHECK(i3_ipc_match_reply(requests, count, I3_MSG_SUBSCRIBE) == &requests[0], "SUBSCRIBE reply");
+    for (size_t i = 0; i < count; ++i) {
+        CHECK(requests[i].received, "request %zu not marked as received", i);
+    }
+}
+
+void test_receive_payload_after_header(void) {
+    I3_Ipc client = {0};
+    I3_Ipc server = {0};
+    socket_pair(&client, &server);
+
+    CHECK(i3_ipc_send(&server, I3_EVENT_WORKSPACE, SV("{\"change\":\"focus\"}")), "send failed: %s", server.error);
+    CHECK(i3_ipc_send(&server, I3_MSG_GET_TREE, SV("{}")), "send failed: %s", server.error);
+
+    I3_Ipc_Header header = {0};
+    String_View payload = {0};
+    CHECK(i3_ipc_receive_header(&client, &header), "receive failed: %s", client.error);
+    CHECK(header.type == I3_EVENT_WORKSPACE, "expected the event first, got type %u", header.type);
+    CHECK(i3_ipc_receive_payload(&client, &header, &payload), "receive failed: %s", client.error);
+    CHECK(sv_eq(payload, SV("{\"change\":\"focus\"}")), "event payload `%.*s`", (int)payload.size, payload.data);
+
+    CHECK(i3_ipc_receive_reply(&client, I3_MSG_GET_TREE, &payload), "receive failed: %s", client.error);
+    CHECK(sv_eq(payload, SV("{}")), "reply payload `%.*s`", (int)payload.size, payload.data);
+
+    // NOTE(nic): anything without the magic is garbage, not a message
+    const char garbage[I3_IPC_HEADER_SIZE] = "i3-icp";
+    CHECK(write(server.fd, garbage, sizeof(garbage)) == sizeof(garbage), "write failed");
+    CHECK(!i3_ipc_receive_header(&client, &header), "garbage taken for a header");
+
+    i3_ipc_close(&client);
+    i3_ipc_close(&server);
+}
+
+void test_empty_payload(void) {
+    I3_Ipc client = {0};
+    I3_Ipc server = {0};
+    socket_pair(&client, &server);
+
+    // NOTE(nic): the first message on a connection, before there is any buffer to point into
+    CHECK(i3_ipc_send(&server, I3_MSG_GET_MARKS, SV("")), "send failed: %s", server.error);
+    I3_Ipc_Header header = {0};
+    String_View payload = {0};
+    CHECK(i3_ipc_receive(&client, &header, &payload), "receive failed: %s", client.error);
+    CHECK(payload.size == 0 && payload.data != NULL, "empty payload of size %zu at %p", payload.size, (void *)payload.data);
+
+    i3_ipc_close(&client);
+    i3_ipc_close(&server);
+}
+
+int main(void) {
+    Arena arena = {0};
+    test_send_requests(&arena);
+    test_match_reply();
+    test_receive_payload_after_header();
+    test_empty_payload();
+    arena_free(&arena);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("i3_ipc_test: ok\n");
+    return 0;
+}
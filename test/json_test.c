@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/json.h"
+#include "../src/json_tape.h"
+#include "../src/utils.h"
+
+#define ARENA_IMPLEMENTATION
+#include "../src/arena.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                          \
+    do {                                                          \
+        if (!(cond)) {                                            \
+            fprintf(stderr, "%s:%d: FAIL: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__);                         \
+            fprintf(stderr, "\n");                                \
+            failures += 1;                                        \
+        }                                                         \
+    } while (0)
+
+// NOTE(nic): lexes until the end or the first error. The index is only attached if it could be built,
+// `*has_index` tells whether it was.
+Json_Result lex_all(Arena *arena, String_View content, bool indexed, bool *has_index) {
+    Json_Lexer lexer = { .content = content };
+    if (indexed) {
+        json_lexer_attach_index(arena, &lexer);
+    }
+    if (has_index != NULL) {
+        *has_index = lexer.index != NULL;
+    }
+    while (true) {
+        Json_Token token = {0};
+        Json_Result result = json_lexer_next(&lexer, &token);
+        if (result.failed || token.kind == JSON_TOKEN_END) {
+            return result;
+        }
+    }
+}
+
+// NOTE(nic): `[0, 0, ..., <literal>, 1]`, padded past JSON_STRUCTURAL_INDEX_MIN_SIZE so it gets indexed
+String_View padded_array(Arena *arena, const char *literal) {
+    String text = {0};
+    str_append_cstr(arena, &text, "[");
+    while (text.count < JSON_STRUCTURAL_INDEX_MIN_SIZE) {
+        str_append_cstr(arena, &text, "0, ");
+    }
+    str_append_fmt(arena, &text, "%s, 1]", literal);
+    return (String_View) { text.items, text.count };
+}
+
+void test_literal_junk(Arena *arena) {
+    const char *junk[] = { "-7\\6", "true!", "null@", "1~", "false#1" };
+    for (size_t i = 0; i < sizeof(junk)/sizeof(*junk); ++i) {
+        String_View text = padded_array(arena, junk[i]);
+
+        bool has_index = false;
+        Json_Result indexed = lex_all(arena, text, true, &has_index);
+        Json_Result unindexed = lex_all(arena, text, false, NULL);
+        CHECK(has_index, "`%s`: expected the lexer to get an index", junk[i]);
+        CHECK(unindexed.failed, "`%s`: expected the byte by byte lexer to fail", junk[i]);
+        CHECK(indexed.failed == unindexed.failed
+              && indexed.error_loc == unindexed.error_loc
+              && indexed.error != NULL && unindexed.error != NULL
+              && strcmp(indexed.error, unindexed.error) == 0,
+              "`%s`: indexed lexer gave `%s` at %zu, byte by byte `%s` at %zu", junk[i],
+              indexed.error ? indexed.error : "ok", indexed.error_loc,
+              unindexed.error ? unindexed.error : "ok", unindexed.error_loc);
+
+        Json_Object object = {0};
+        Json_Result result = json_parse(arena, &object, text.data, text.size);
+        CHECK(result.failed && result.error_loc == unindexed.error_loc, "`%s`: json_parse accepted it", junk[i]);
+
+        Json_Tape tape = {0};
+        result = json_tape_parse(arena, &tape, text.data, text.size);
+        CHECK(result.failed && result.error_loc == unindexed.error_loc, "`%s`: json_tape_parse accepted it", junk[i]);
+    }
+}
+
+void test_literal_valid(Arena *arena) {
+    const char *valid[] = { "-7", "true", "null", "1e5", "\"x\"" };
+    for (size_t i = 0; i < sizeof(valid)/sizeof(*valid); ++i) {
+        String_View text = padded_array(arena, valid[i]);
+        bool has_index = false;
+        Json_Result indexed = lex_all(arena, text, true, &has_index);
+        Json_Result unindexed = lex_all(arena, text, false, NULL);
+        CHECK(has_index, "`%s`: expected the lexer to get an index", valid[i]);
+        CHECK(!indexed.failed && !unindexed.failed, "`%s`: expected both lexers to accept it", valid[i]);
+    }
+}
+
+void test_append_to_parsed_string(Arena *arena) {
+    const char *text = "[\"hello\"]";
+    Json_Object object = {0};
+    Json_Result result = json_parse(arena, &object, text, strlen(text));
+    CHECK(!result.failed, "could not parse `%s`: %s", text, result.error);
+    if (result.failed) {
+        return;
+    }
+
+    String *string = &json_array_get(&object.as.array, 0)->as.string;
+    str_append_cstr(arena, string, "!");
+    CHECK(string->count == 6 && memcmp(string->items, "hello!", 6) == 0,
+          "expected `hello!`, got `%.*s`", (int)string->count, string->items);
+    CHECK(strcmp(text, "[\"hello\"]") == 0, "appending wrote into the parsed input");
+}
+
+size_t arena_used_bytes(Arena *arena) {
+    size_t used = 0;
+    for (Region *region = arena->begin; region != NULL; region = region->next) {
+        used += region->count * sizeof(uintptr_t);
+    }
+    return used;
+}
+
+void test_exactly_sized_containers(Arena *arena) {
+    const char *text = "{\"a\": [1, [2, 3], {\"b\": []}], \"c\": {\"d\": 4, \"e\": [5]}, \"f\": {}}";
+    Json_Object root = {0};
+    Json_Result result = json_parse(arena, &root, text, strlen(text));
+    CHECK(!result.failed, "could not parse `%s`: %s", text, result.error);
+    if (result.failed) {
+        return;
+    }
+    Json_Array *a = json_dict_get_array(&root.as.dict, JSON_OBJ_STR_FROM_CSTR_LIT("a"));
+    Json_Dict *c = json_dict_get_dict(&root.as.dict, JSON_OBJ_STR_FROM_CSTR_LIT("c"));
+    Json_Dict *f = json_dict_get_dict(&root.as.dict, JSON_OBJ_STR_FROM_CSTR_LIT("f"));
+    CHECK(root.as.dict.count == 3 && root.as.dict.capacity == 3, "root has %u of %u", root.as.dict.count, root.as.dict.capacity);
+    CHECK(a != NULL && a->count == 3 && a->capacity == 3, "`a` is not sized to its items");
+    CHECK(c != NULL && c->count == 2 && c->capacity == 2, "`c` is not sized to its items");
+    CHECK(f != NULL && f->count == 0 && f->items == NULL, "`f` should be empty");
+    if (a == NULL || c == NULL) {
+        return;
+    }
+    Json_Array *inner = json_array_get_array(a, 1);
+    Json_Array *e = json_dict_get_array(c, JSON_OBJ_STR_FROM_CSTR_LIT("e"));
+    CHECK(inner != NULL && inner->count == 2 && inner->items[0].as.int64 == 2 && inner->items[1].as.int64 == 3,
+          "`a[1]` should be [2, 3]");
+    CHECK(e != NULL && e->count == 1 && e->items[0].as.int64 == 5, "`c.e` should be [5]");
+
+    // NOTE(nic): full buffers still grow like any other dynamic array
+    Json_Object item = { .kind = JSON_OBJ_INT64, .as.int64 = 6 };
+    arena_da_append(arena, a, item);
+    CHECK(a->count == 4 && a->items[0].as.int64 == 1 && a->items[3].as.int64 == 6, "appending lost the parsed items");
+
+    // NOTE(nic): one small dict per window is the shape of an i3 tree, none of them may cost more than its pairs
+    String many = {0};
+    str_append_cstr(arena, &many, "[");
+    for (size_t i = 0; i < 1000; ++i) {
+        str_append_fmt(arena, &many, "%s{\"id\": %zu}", (i > 0) ? ", " : "", i);
+    }
+    str_append_cstr(arena, &many, "]");
+    Arena parse_arena = {0};
+    Json_Object windows = {0};
+    result = json_parse(&parse_arena, &windows, many.items, many.count);
+    CHECK(!result.failed && windows.as.array.count == 1000, "could not parse 1000 dicts");
+    size_t used = arena_used_bytes(&parse_arena);
+    CHECK(used < 32 * many.count, "parsing %zu bytes used %zu bytes of arena", many.count, used);
+    arena_free(&parse_arena);
+}
+
+void test_interned_lookup(Arena *arena) {
+    const char *text = "{\"id\": 1, \"type\": \"con\", \"name\": \"a\", \"layout\": \"splith\", \"border\": \"none\","
+                       " \"urgent\": false, \"focused\": true, \"marks\": [], \"nodes\": [2, 3], \"w\\u0069ndow\": 4}";
+    Json_Interner interner = {0};
+    // NOTE(nic): one key interned before the parse, the rest after it, both have to end up shared
+    Json_Object nodes = json_intern_key(arena, &interner, "nodes");
+    Json_Object root = {0};
+    Json_Result result = json_parse_interned(arena, &interner, &root, text, strlen(text));
+    CHECK(!result.failed, "could not parse `%s`: %s", text, result.error);
+    if (result.failed) {
+        return;
+    }
+    Json_Dict *dict = &root.as.dict;
+    CHECK(dict->index != NULL, "expected a dict of %u keys to get an index", dict->count);
+
+    Json_Object name = json_intern_key(arena, &interner, "name");
+    Json_Object window = json_intern_key(arena, &interner, "window");
+    Json_Object missing = json_intern_key(arena, &interner, "missing");
+    CHECK(json_dict_get(dict, missing) == NULL, "found a key that is not there");
+
+    Json_Key_Value_Pair *pair = json_dict_find_pair(dict, &nodes);
+    CHECK(pair != NULL && pair->key.as.string.items == nodes.as.string.items, "`nodes` not found by pointer");
+    CHECK(pair != NULL && pair->value.kind == JSON_OBJ_ARRAY && pair->value.as.array.count == 2, "wrong value for `nodes`");
+    pair = json_dict_find_pair(dict, &name);
+    CHECK(pair != NULL && pair->key.as.string.items == name.as.string.items, "`name` not found by pointer");
+    // NOTE(nic): escaped keys are not shared, they are still found by their bytes
+    Json_Object *value = json_dict_get(dict, window);
+    CHECK(value != NULL && value->kind == JSON_OBJ_INT64 && value->as.int64 == 4, "escaped key `window` not found");
+}
+
+// NOTE(nic): the push parser gets its input one byte at a time, so every token is split at every point
+Json_Result push_parse(Arena *arena, String_View text) {
+    Json_Tape_Parser parser = {0};
+    for (size_t i = 0; i < text.size; ++i) {
+        Json_Result result = json_tape_parser_feed(arena, &parser, &text.data[i], 1);
+        if (result.failed) {
+            return result;
+        }
+    }
+    return json_tape_parser_finish(arena, &parser);
+}
+
+void test_invalid_escape(Arena *arena) {
+    const char *strings[] = { "\"a\\qb\"", "\"a\\u12x4\"", "\"\\u12\"" };
+    for (size_t i = 0; i < sizeof(strings)/sizeof(*strings); ++i) {
+        String_View texts[2] = {0};
+        String small = {0};
+        str_append_fmt(arena, &small, "[%s]", strings[i]);
+        texts[0] = (String_View) { small.items, small.count };
+        texts[1] = padded_array(arena, strings[i]);
+
+        for (size_t j = 0; j < 2; ++j) {
+            String_View text = texts[j];
+            Json_Result expected = lex_all(arena, text, false, NULL);
+            CHECK(expected.failed, "`%s`: expected the byte by byte lexer to fail", strings[i]);
+            if (j == 1) {
+                // NOTE(nic): the index refuses invalid escapes, the byte by byte lexer reports them
+                Json_Result indexed = lex_all(arena, text, true, NULL);
+                CHECK(indexed.failed && indexed.error_loc == expected.error_loc,
+                      "`%s`: indexed lexer gave `%s` at %zu, byte by byte `%s` at %zu", strings[i],
+                      indexed.error ? indexed.error : "ok", indexed.error_loc,
+                      expected.error ? expected.error : "ok", expected.error_loc);
+            }
+
+            Json_Object object = {0};
+            Json_Result result = json_parse(arena, &object, text.data, text.size);
+            CHECK(result.failed && result.error_loc == expected.error_loc, "`%s`: json_parse accepted it", strings[i]);
+
+            Json_Tape tape = {0};
+            result = json_tape_parse(arena, &tape, text.data, text.size);
+            CHECK(result.failed && result.error_loc == expected.error_loc,
+                  "`%s`: json_tape_parse accepted it", strings[i]);
+
+            result = push_parse(arena, text);
+            CHECK(result.failed && result.error_loc == expected.error_loc,
+                  "`%s`: the push parser gave `%s` at %zu, expected `%s` at %zu", strings[i],
+                  result.error ? result.error : "ok", result.error_loc,
+                  expected.error ? expected.error : "ok", expected.error_loc);
+        }
+    }
+}
+
+uint16_t only_id_key(String_View key) {
+    return sv_eq(key, SV("id")) ? 1 : JSON_TAPE_KEY_UNKNOWN;
+}
+
+// NOTE(nic): like push_parse, keeping only `id` pairs. With `whole` set the input goes in with a single feed.
+Json_Result projected_parse(Arena *arena, String_View text, bool whole, Json_Tape *tape) {
+    Json_Tape_Parser parser = {0};
+    parser.key_id = only_id_key;
+    parser.known_keys_only = true;
+    size_t step = whole ? text.size : 1;
+    for (size_t i = 0; i < text.size; i += step) {
+        Json_Result result = json_tape_parser_feed(arena, &parser, &text.data[i], step);
+        if (result.failed) {
+            return result;
+        }
+    }
+    Json_Result result = json_tape_parser_finish(arena, &parser);
+    *tape = parser.tape;
+    return result;
+}
+
+void test_projected_invalid(Arena *arena) {
+    const char *texts[] = {
+        "{\"id\":1,\"rect\":[}}",
+        "{\"id\":1,\"rect\":{x y z}}",
+        "{\"id\":1,\"rect\":tru}",
+        "{\"id\":1,\"rect\":\"a\\q\"}",
+        "{\"id\":1,\"rect\":{\"x\":1]}",
+        "{\"id\":1,\"rect\":{\"x\" 1}}",
+        "{\"id\":1,\"rect\":[1 2]}",
+        "{\"id\":1,\"rect\":{1:2}}",
+        "{\"id\":1,\"rect\":}",
+        "{\"id\":1,\"rect\":[1,]}",
+    };
+    for (size_t i = 0; i < sizeof(texts)/sizeof(*texts); ++i) {
+        String_View text = SV(texts[i]);
+        // NOTE(nic): the same parser keeping every pair is what projecting must agree with
+        Json_Tape tape = {0};
+        Json_Result expected = push_parse(arena, text);
+        CHECK(expected.failed, "`%s`: expected the push parser to fail", texts[i]);
+        for (size_t whole = 0; whole < 2; ++whole) {
+            Json_Result result = projected_parse(arena, text, whole, &tape);
+            CHECK(result.failed && result.error_loc == expected.error_loc,
+                  "`%s`: projected parse gave `%s` at %zu, expected `%s` at %zu", texts[i],
+                  result.error ? result.error : "ok", result.error_loc,
+                  expected.error ? expected.error : "ok", expected.error_loc);
+        }
+    }
+
+    const char *valid = "{\"rect\":{\"x\":[1,-2.5e3,{\"a\":null}],\"y\":\"\\u00e9\\\"\",\"z\":[]},\"id\":7,\"b\":[true,false,{}]}";
+    for (size_t whole = 0; whole < 2; ++whole) {
+        Json_Tape tape = {0};
+        Json_Result result = projected_parse(arena, SV(valid), whole, &tape);
+        CHECK(!result.failed, "`%s`: projected parse failed with `%s` at %zu", valid, result.error, result.error_loc);
+        if (!result.failed) {
+            CHECK(tape.items[0].size == 1 && tape.count == 3, "`%s`: expected only `id` on the tape", valid);
+        }
+    }
+}
+
+// NOTE(nic): walking `size` items (two entries per pair in dicts) from a container has to land on its `end`
+bool tape_consistent(Json_Tape *tape, size_t index) {
+    Json_Tape_Entry *entry = &tape->items[index];
+    if (entry->kind != JSON_OBJ_DICT && entry->kind != JSON_OBJ_ARRAY) {
+        return true;
+    }
+    size_t curr = index + 1;
+    size_t items = (entry->kind == JSON_OBJ_DICT) ? 2*entry->size : entry->size;
+    for (size_t i = 0; i < items; ++i) {
+        if (curr >= entry->as.end || !tape_consistent(tape, curr)) {
+            return false;
+        }
+        curr = json_tape_skip(tape, curr);
+    }
+    return curr == entry->as.end;
+}
+
+bool stop_at_target(void *user_data, Json_Tape_Parser *parser, size_t container) {
+    (void) user_data;
+    Json_Tape_Entry *entry = &parser->tape.items[container];
+    return entry->kind == JSON_OBJ_ARRAY && entry->size > 0
+        && parser->tape.items[container + 1].kind == JSON_OBJ_INT64
+        && parser->tape.items[container + 1].as.int64 == 7;
+}
+
+void test_stopped_tape(Arena *arena) {
+    const char *text =
+        "{\"a\": 1, \"nodes\": [{\"x\": [1]}, {\"y\": 2, \"target\": [7, 8], \"z\": 3}, {}], \"b\": 3}";
+    Json_Tape_Parser parser = {0};
+    parser.on_close = stop_at_target;
+    Json_Result result = json_tape_parser_feed(arena, &parser, text, strlen(text));
+    if (!result.failed) {
+        result = json_tape_parser_finish(arena, &parser);
+    }
+    CHECK(!result.failed && parser.stopped, "expected the parse to stop at the target");
+    if (result.failed || !parser.stopped) {
+        return;
+    }
+
+    Json_Tape *tape = &parser.tape;
+    CHECK(tape_consistent(tape, 0), "sizes and ends of the stopped tape do not match");
+    CHECK(tape->items[0].size == 2, "root should hold `a` and `nodes`, holds %u pairs", tape->items[0].size);
+    size_t nodes = json_tape_dict_get(tape, 0, SV("nodes"));
+    CHECK(nodes != JSON_TAPE_NONE && tape->items[nodes].size == 2,
+          "`nodes` should hold 2 items, holds %u", (nodes != JSON_TAPE_NONE) ? tape->items[nodes].size : 0);
+    if (nodes != JSON_TAPE_NONE && tape->items[nodes].size == 2) {
+        size_t item = json_tape_array_get(tape, nodes, 1);
+        CHECK(tape->items[item].size == 2, "the dict around the target should hold 2 pairs");
+        CHECK(json_tape_dict_get(tape, item, SV("target")) != JSON_TAPE_NONE, "the target should be in there");
+    }
+}
+
+int main(void) {
+    Arena arena = {0};
+    test_literal_junk(&arena);
+    test_literal_valid(&arena);
+    test_append_to_parsed_string(&arena);
+    test_exactly_sized_containers(&arena);
+    test_interned_lookup(&arena);
+    test_invalid_escape(&arena);
+    test_projected_invalid(&arena);
+    test_stopped_tape(&arena);
+    arena_free(&arena);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("json_test: ok\n");
+    return 0;
+}